@@ -14,13 +14,22 @@ Source0:    %{name}-%{version}.tar.bz2
 BuildRequires:  pkgconfig(Qt5Core)
 BuildRequires:  pkgconfig(Qt5Qml)
 BuildRequires:  pkgconfig(Qt5Quick)
+BuildRequires:  pkgconfig(Qt5Test)
 BuildRequires:  pkgconfig(gstreamer-1.0)
 BuildRequires:  pkgconfig(gstreamer-pbutils-1.0)
+BuildRequires:  pkgconfig(gstreamer-plugins-bad-1.0)
 BuildRequires:  desktop-file-utils
 
 %description
 Commandline tool to get droidcam camera resolutions
 
+%package devel
+Summary:    Reader for the droid-camres capability blob
+Group:      Development/Libraries
+
+%description devel
+Header for reading the binary capability blob written by droid-camres
+
 %prep
 %setup -q -n %{name}-%{version}
 
@@ -38,3 +47,7 @@ rm -rf %{buildroot}
 %defattr(-,root,root,-)
 %{_bindir}/*
 %{_datadir}/%{name}
+
+%files devel
+%defattr(-,root,root,-)
+%{_includedir}/%{name}
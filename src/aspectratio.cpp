@@ -0,0 +1,83 @@
+#include "aspectratio.h"
+
+#include <stdlib.h>
+
+// Sorted by ascending width / height
+static constexpr AspectRatio ratios[] = {
+    { 3, 4, "3:4" },
+    { 4, 5, "4:5" },
+    { 1, 1, "1:1" },
+    { 11, 9, "11:9" },
+    { 5, 4, "5:4" },
+    { 4, 3, "4:3" },
+    { 3, 2, "3:2" },
+    { 16, 10, "16:10" },
+    { 5, 3, "5:3" },
+    { 16, 9, "16:9" },
+    { 9, 5, "9:5" },
+    { 17, 9, "17:9" },
+    { 2, 1, "2:1" }
+};
+
+static constexpr AspectRatio unknownRatio = { 0, 0, "?:?" };
+
+static constexpr int ratioCount = sizeof(ratios) / sizeof(ratios[0]);
+
+static constexpr bool ratiosSorted(int i)
+{
+    return i + 1 >= ratioCount ||
+           (ratios[i].num * ratios[i + 1].den < ratios[i + 1].num * ratios[i].den && ratiosSorted(i + 1));
+}
+
+static_assert(ratiosSorted(0), "aspect ratio table must be sorted");
+
+const AspectRatio &AspectRatio::classify(int width, int height, double tolerance)
+{
+    const AspectRatio *best = &unknownRatio;
+    double bestError = tolerance;
+    int i;
+
+    if (width <= 0 || height <= 0)
+    {
+        return unknownRatio;
+    }
+
+    for (i=0 ; i<ratioCount ; i++)
+    {
+        qint64 lhs = (qint64)width * ratios[i].den;
+        qint64 rhs = (qint64)height * ratios[i].num;
+
+        if (lhs == rhs)
+        {
+            return ratios[i];
+        }
+
+        double error = (double)llabs(lhs - rhs) / rhs;
+
+        if (error <= bestError)
+        {
+            best = &ratios[i];
+            bestError = error;
+        }
+    }
+
+    return *best;
+}
+
+const AspectRatio &AspectRatio::classify(const CamMode &mode, double tolerance)
+{
+    return classify(mode.width, mode.height, tolerance);
+}
+
+void AspectRatio::classify(const CamModeList &modes, const AspectRatio **res, double tolerance)
+{
+    int i;
+
+    for (i=0 ; i<modes.size() ; i++)
+        res[i] = &classify(modes.at(i).width, modes.at(i).height, tolerance);
+}
+
+const AspectRatio &AspectRatio::unknown()
+{
+    return unknownRatio;
+}
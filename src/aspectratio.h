@@ -0,0 +1,34 @@
+#ifndef ASPECTRATIO_H
+#define ASPECTRATIO_H
+
+#include "cammode.h"
+
+/*
+ * Aspect ratio classifier backed by a constant table of known ratios.
+ *
+ * A resolution matches a ratio when width * den equals height * num, or
+ * when the relative difference is within the given tolerance. Nothing is
+ * allocated and there is no lazily initialised state, so the classifier
+ * is safe to call from any thread.
+ */
+struct AspectRatio
+{
+    int num;
+    int den;
+    const char *name;
+
+    bool isValid() const { return den != 0; }
+    bool is(int n, int d) const { return num == n && den == d; }
+
+    static constexpr double DefaultTolerance = 0.01;
+
+    static const AspectRatio &classify(int width, int height, double tolerance = DefaultTolerance);
+    static const AspectRatio &classify(const CamMode &mode, double tolerance = DefaultTolerance);
+
+    // Classifies modes.size() modes into ratios, which must hold that many entries.
+    static void classify(const CamModeList &modes, const AspectRatio **ratios, double tolerance = DefaultTolerance);
+
+    static const AspectRatio &unknown();
+};
+
+#endif // ASPECTRATIO_H
@@ -0,0 +1,263 @@
+#include "batch.h"
+#include "camres.h"
+#include "outputgen.h"
+#include "recording.h"
+#include "screengeometry.h"
+#include "viewfinderindex.h"
+#include "photography.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QVector>
+
+#include <gst/gst.h>
+
+#define BATCH_VERSION 1
+
+class BatchTask : public QRunnable
+{
+public:
+    BatchTask(const QList<Batch::Device> &devices, const QHash<QString, CamhwTemplate> &templates,
+              QAtomicInt *next, QVector<Batch::Result> *results) :
+        m_devices(devices), m_templates(templates), m_next(next), m_results(results)
+    {
+    }
+
+    void run()
+    {
+        int n;
+        while ((n = m_next->fetchAndAddOrdered(1)) < m_devices.size())
+            (*m_results)[n] = Batch::process(m_devices.at(n), m_templates);
+    }
+
+private:
+    QList<Batch::Device> m_devices;
+    QHash<QString, CamhwTemplate> m_templates;
+    QAtomicInt *m_next;
+    QVector<Batch::Result> *m_results;
+};
+
+static QString manifestPath(const QDir &dir, GKeyFile *keyFile, const gchar *group, const char *key)
+{
+    gchar *value = g_key_file_get_string(keyFile, group, key, NULL);
+    QString res;
+
+    if (value && *value)
+        res = QDir::cleanPath(dir.absoluteFilePath(QString::fromUtf8(value)));
+
+    g_free(value);
+
+    return res;
+}
+
+Batch::Batch(QObject *parent) :
+    QObject(parent)
+{
+}
+
+bool Batch::loadManifest(const QString &manifest, QList<Device> &devices)
+{
+    GKeyFile *keyFile = g_key_file_new();
+    GError *error = NULL;
+    gsize count = 0;
+    gsize i;
+
+    if (!g_key_file_load_from_file(keyFile, manifest.toLocal8Bit().constData(), G_KEY_FILE_NONE, &error))
+    {
+        qCritical("Camres error: Failed to load manifest %s: %s", qPrintable(manifest), error->message);
+        g_error_free(error);
+        g_key_file_free(keyFile);
+        return false;
+    }
+
+    if (g_key_file_get_integer(keyFile, "droid-camres-batch", "version", NULL) > BATCH_VERSION)
+    {
+        qCritical("Camres error: Manifest %s has an unsupported version.", qPrintable(manifest));
+        g_key_file_free(keyFile);
+        return false;
+    }
+
+    QDir dir = QFileInfo(manifest).absoluteDir();
+    gchar **groups = g_key_file_get_groups(keyFile, &count);
+
+    for (i=0 ; i<count ; i++)
+    {
+        if (g_strcmp0(groups[i], "droid-camres-batch") == 0)
+            continue;
+
+        Device device;
+        gchar *screen = g_key_file_get_string(keyFile, groups[i], "screen", NULL);
+
+        device.name = QString::fromUtf8(groups[i]);
+        device.recording = manifestPath(dir, keyFile, groups[i], "recording");
+        device.screen = ScreenGeometry::fromString(QString::fromUtf8(screen));
+        device.json = manifestPath(dir, keyFile, groups[i], "json");
+        device.blob = manifestPath(dir, keyFile, groups[i], "blob");
+        device.camhw = manifestPath(dir, keyFile, groups[i], "camhw");
+        device.camhwTemplate = manifestPath(dir, keyFile, groups[i], "template");
+        g_free(screen);
+
+        if (device.camhwTemplate.isEmpty())
+            device.camhwTemplate = CAMHW_TEMPLATE;
+
+        if (g_key_file_has_key(keyFile, groups[i], "memory-budget", NULL))
+            device.memoryBudget = g_key_file_get_int64(keyFile, groups[i], "memory-budget", NULL) * 1024 * 1024;
+
+        devices.append(device);
+    }
+
+    g_strfreev(groups);
+    g_key_file_free(keyFile);
+
+    return true;
+}
+
+Batch::Result Batch::process(const Device &device, const QHash<QString, CamhwTemplate> &templates)
+{
+    QList<QPair<QString, int> > cameras;
+    QList<QList<QPair<QString, QString> > > caps;
+    QList<Photography> photography;
+    QElapsedTimer timer;
+    Result res;
+    int i, j;
+
+    timer.start();
+
+    if (device.recording.isEmpty() || !device.screen.isValid())
+    {
+        qCritical("Camres error: %s needs a recording and a screen size.", qPrintable(device.name));
+        return res;
+    }
+
+    if (!Recording::load(device.recording, cameras, caps, photography))
+    {
+        return res;
+    }
+
+    QList<QList<QPair<QString, CamModeList> > > resolutions = Camres::parse(caps);
+    QList<ViewfinderIndex> viewfinders = ViewfinderIndex::build(resolutions, device.screen, device.memoryBudget);
+    QList<CameraPlan> plans = CameraPlan::build(cameras, resolutions, viewfinders, device.memoryBudget,
+                                                photography);
+    OutputGen og;
+
+    res.ok = true;
+
+    if (!device.json.isEmpty())
+    {
+        QDir().mkpath(QFileInfo(device.json).path());
+        res.ok = og.makeJson(plans, device.json) && res.ok;
+    }
+
+    if (!device.blob.isEmpty())
+    {
+        QDir().mkpath(QFileInfo(device.blob).path());
+        res.ok = og.makeBlob(plans, device.blob) && res.ok;
+    }
+
+    if (!device.camhw.isEmpty())
+    {
+        QHash<QString, CamhwTemplate>::const_iterator camhwTemplate = templates.constFind(device.camhwTemplate);
+
+        if (camhwTemplate == templates.constEnd())
+        {
+            qCritical("Camres error: Template %s of %s could not be read.", qPrintable(device.camhwTemplate), qPrintable(device.name));
+            res.ok = false;
+        }
+        else
+        {
+            QDir().mkpath(QFileInfo(device.camhw).path());
+            res.ok = og.makeCamhw(plans, camhwTemplate.value(), device.camhw) && res.ok;
+        }
+    }
+
+    res.cameras = cameras.size();
+    for (i=0 ; i<resolutions.size() ; i++)
+        for (j=0 ; j<resolutions.at(i).size() ; j++)
+            res.modes += resolutions.at(i).at(j).second.size();
+    res.elapsed = timer.elapsed();
+
+    return res;
+}
+
+bool Batch::run(const QString &manifest, int jobs)
+{
+    QList<Device> devices;
+    int failed = 0;
+    int i;
+
+    gst_init(0, 0);
+
+    if (!loadManifest(manifest, devices))
+    {
+        return false;
+    }
+
+    if (devices.isEmpty())
+    {
+        qCritical("Camres error: Manifest %s has no devices.", qPrintable(manifest));
+        return false;
+    }
+
+    QHash<QString, CamhwTemplate> templates;
+    QSet<QString> missing;
+
+    // Read-only once loaded, so the threads share them
+    for (i=0 ; i<devices.size() ; i++)
+    {
+        const QString &filename = devices.at(i).camhwTemplate;
+
+        if (devices.at(i).camhw.isEmpty() || templates.contains(filename) || missing.contains(filename))
+            continue;
+
+        CamhwTemplate camhwTemplate;
+
+        if (camhwTemplate.load(filename))
+        {
+            templates.insert(filename, camhwTemplate);
+        }
+        else
+        {
+            qCritical("Camres error: failed to open template %s", qPrintable(filename));
+            missing.insert(filename);
+        }
+    }
+
+    QVector<Result> results(devices.size());
+    QAtomicInt next(0);
+    QElapsedTimer wallClock;
+    QThreadPool pool;
+
+    jobs = qBound(1, jobs, devices.size());
+    pool.setMaxThreadCount(jobs);
+    wallClock.start();
+
+    for (i=0 ; i<jobs ; i++)
+        pool.start(new BatchTask(devices, templates, &next, &results));
+
+    pool.waitForDone();
+
+    qint64 elapsed = wallClock.elapsed();
+
+    qInfo("\nBatch results:");
+
+    for (i=0 ; i<devices.size() ; i++)
+    {
+        const Result &r = results.at(i);
+
+        if (!r.ok)
+            failed++;
+
+        qInfo("%-24s %s %4d cameras %6d modes %8lld ms", qPrintable(devices.at(i).name),
+              r.ok ? "ok    " : "FAILED", r.cameras, r.modes, r.elapsed);
+    }
+
+    qInfo("Camres: Generated %d devices in %lld ms wall clock (%.1f devices/s, %d jobs), %d failed",
+          devices.size(), elapsed, elapsed > 0 ? devices.size() * 1000.0 / elapsed : 0.0, jobs, failed);
+
+    return failed == 0;
+}
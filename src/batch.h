@@ -0,0 +1,77 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <QObject>
+#include <QHash>
+#include <QRect>
+#include <QStringList>
+
+#include "camhwtemplate.h"
+
+/*
+ * Generates the outputs of many devices in one run from their recorded
+ * probe results. Devices are processed concurrently on a thread pool, a
+ * failing device is reported and does not stop the others.
+ *
+ * Manifest (GKeyFile), one group per device:
+ *
+ *   [droid-camres-batch]
+ *   version=1
+ *
+ *   [device-name]
+ *   recording=device.camres    see Recording
+ *   screen=1080x2340
+ *   json=device/camera-resolutions.json
+ *   blob=device/camera-resolutions.bin
+ *   camhw=device/jolla-camera-hw.txt
+ *   template=jolla-camera-hw-template.txt
+ *   memory-budget=256
+ *
+ * json, blob and camhw are optional, template defaults to CAMHW_TEMPLATE and
+ * memory-budget (in MB) to no limit. Relative paths are relative to the
+ * manifest. Each distinct template is read once, before the devices are
+ * processed.
+ */
+class Batch : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Batch(QObject *parent = 0);
+
+    // gst_init() is called here, set up the environment before
+    bool run(const QString &manifest, int jobs);
+
+    struct Device
+    {
+        Device() : memoryBudget(-1) {}
+
+        QString name;
+        QString recording;
+        QRect screen;
+        QString json;
+        QString blob;
+        QString camhw;
+        QString camhwTemplate;
+        qint64 memoryBudget;
+    };
+
+    struct Result
+    {
+        Result() : ok(false), cameras(0), modes(0), elapsed(0) {}
+
+        bool ok;
+        int cameras;
+        int modes;
+        qint64 elapsed;
+    };
+
+    // templates holds the camhw templates of the devices by filename,
+    // loaded once and shared between the threads
+    static Result process(const Device &device, const QHash<QString, CamhwTemplate> &templates);
+
+private:
+    bool loadManifest(const QString &manifest, QList<Device> &devices);
+};
+
+#endif // BATCH_H
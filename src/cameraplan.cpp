@@ -0,0 +1,112 @@
+#include "cameraplan.h"
+
+#include <QSet>
+#include <QVarLengthArray>
+
+static bool fasterThan(const CamMode &a, const CamMode &b)
+{
+    return (qint64)a.fpsMaxNum * b.fpsMaxDen > (qint64)b.fpsMaxNum * a.fpsMaxDen;
+}
+
+CameraPlan::CameraPlan(const QPair<QString, int> &camera,
+                       const QList<QPair<QString, CamModeList> > &resolutions,
+                       const ViewfinderIndex &viewfinders,
+                       qint64 memoryBudget) :
+    m_name(camera.first),
+    m_device(camera.second),
+    m_memoryBudget(memoryBudget)
+{
+    CamModeList videoModes;
+    int j, m;
+
+    for (j=0 ; j<resolutions.size() ; j++)
+    {
+        const CamModeList &res = resolutions.at(j).second;
+        QVarLengthArray<const AspectRatio *, 64> ratios(res.size());
+        QSet<QPair<int, int> > offered;
+        PlanList list;
+
+        list.caps = resolutions.at(j).first;
+        list.kind = CamMode::kindForCaps(list.caps);
+        AspectRatio::classify(res, ratios.data());
+
+        for (m=0 ; m<res.size() ; m++)
+        {
+            PlanMode planned;
+            const CamMode &mode = res.at(m);
+            bool fits = memoryBudget < 0 || mode.footprint() <= memoryBudget;
+
+            planned.mode = mode;
+            planned.aspect = ratios.at(m);
+
+            if (list.kind == CamMode::Viewfinder)
+            {
+                planned.stats = viewfinders.stats(mode);
+                list.modes.append(planned);
+
+                if (ratios.at(m)->isValid() && !m_viewfinder.contains(ratios.at(m)))
+                    m_viewfinder.insert(ratios.at(m), viewfinders.find(*ratios.at(m)));
+                continue;
+            }
+
+            planned.viewfinder = viewfinders.find(*ratios.at(m));
+            planned.stats = viewfinders.stats(planned.viewfinder);
+            list.modes.append(planned);
+
+            if (!fits)
+                continue;
+
+            if (list.kind == CamMode::Video)
+                videoModes.append(mode);
+
+            if (!offered.contains(qMakePair(mode.width, mode.height)))
+            {
+                list.offered.append(planned);
+                offered.insert(qMakePair(mode.width, mode.height));
+            }
+
+            if (!ratios.at(m)->isValid())
+                continue;
+
+            if (list.kind == CamMode::Image)
+            {
+                CamMode best = m_image.value(ratios.at(m));
+                if (!best.isValid() || mode.area() > best.area())
+                    m_image.insert(ratios.at(m), mode);
+            }
+            else if (list.kind == CamMode::Video && mode.hasFramerate())
+            {
+                CamMode best = m_video.value(ratios.at(m));
+                if (!best.isValid() || mode.area() > best.area() ||
+                    (mode.area() == best.area() && fasterThan(mode, best)))
+                    m_video.insert(ratios.at(m), mode);
+            }
+        }
+
+        m_lists.append(list);
+    }
+
+    m_tiers = VideoTiers::select(videoModes);
+}
+
+QList<CameraPlan> CameraPlan::build(const QList<QPair<QString, int> > &cameras,
+                                    const QList<QList<QPair<QString, CamModeList> > > &resolutions,
+                                    const QList<ViewfinderIndex> &viewfinders,
+                                    qint64 memoryBudget,
+                                    const QList<Photography> &photography)
+{
+    QList<CameraPlan> res;
+    int i;
+
+    for (i=0 ; i<cameras.size() && i<resolutions.size() ; i++)
+    {
+        res.append(CameraPlan(cameras.at(i), resolutions.at(i),
+                              i < viewfinders.size() ? viewfinders.at(i) : ViewfinderIndex(),
+                              memoryBudget));
+
+        if (i < photography.size())
+            res.last().setPhotography(photography.at(i));
+    }
+
+    return res;
+}
@@ -0,0 +1,102 @@
+#ifndef CAMERAPLAN_H
+#define CAMERAPLAN_H
+
+#include <QHash>
+#include <QList>
+#include <QVector>
+
+#include "cammode.h"
+#include "aspectratio.h"
+#include "videotiers.h"
+#include "viewfinderindex.h"
+#include "photography.h"
+
+/*
+ * A mode of the plan with its aspect ratio and the viewfinder shown
+ * while capturing it. For viewfinder modes stats are their own
+ * measurements, for capture modes those of the matching viewfinder.
+ */
+struct PlanMode
+{
+    PlanMode() : aspect(&AspectRatio::unknown()) {}
+
+    CamMode mode;
+    const AspectRatio *aspect;
+    CamMode viewfinder;
+    ViewfinderStats stats;
+};
+
+/*
+ * The modes of one caps property of a camera. modes holds everything
+ * advertised, in order. offered holds the capture modes that are
+ * offered to the user: one per resolution, within the memory budget.
+ */
+struct PlanList
+{
+    QString caps;
+    CamMode::Kind kind;
+    QVector<PlanMode> modes;
+    QVector<PlanMode> offered;
+};
+
+/*
+ * Everything the outputs need to know about one camera, decided once.
+ * The dump, JSON and dconf generators only serialise the plan, so they
+ * agree by construction.
+ *
+ * Selection rules:
+ * - best image per aspect ratio: the largest one
+ * - best video per aspect ratio: the largest one, at its highest
+ *   framerate
+ * - best viewfinder per aspect ratio: the largest one on the screen,
+ *   preferring the ones delivered at full rate, see ViewfinderIndex
+ * - video tiers: see VideoTiers
+ * The photography capabilities are carried over as probed.
+ * Modes whose buffers do not fit in the memory budget are never chosen.
+ */
+class CameraPlan
+{
+public:
+    CameraPlan(const QPair<QString, int> &camera,
+               const QList<QPair<QString, CamModeList> > &resolutions,
+               const ViewfinderIndex &viewfinders,
+               qint64 memoryBudget = -1);
+
+    // viewfinders may be empty when no screen size is known, photography
+    // when the capabilities were not probed
+    static QList<CameraPlan> build(const QList<QPair<QString, int> > &cameras,
+                                   const QList<QList<QPair<QString, CamModeList> > > &resolutions,
+                                   const QList<ViewfinderIndex> &viewfinders,
+                                   qint64 memoryBudget = -1,
+                                   const QList<Photography> &photography = QList<Photography>());
+
+    const QString &name() const { return m_name; }
+    int device() const { return m_device; }
+    bool isEmpty() const { return m_lists.isEmpty(); }
+    // Negative when there is no limit
+    qint64 memoryBudget() const { return m_memoryBudget; }
+
+    const QList<PlanList> &lists() const { return m_lists; }
+    const QList<VideoTier> &tiers() const { return m_tiers; }
+    // Empty when not probed
+    const Photography &photography() const { return m_photography; }
+    void setPhotography(const Photography &photography) { m_photography = photography; }
+
+    // Invalid modes when there is none
+    CamMode image(const AspectRatio &aspect) const { return m_image.value(&aspect); }
+    CamMode video(const AspectRatio &aspect) const { return m_video.value(&aspect); }
+    CamMode viewfinder(const AspectRatio &aspect) const { return m_viewfinder.value(&aspect); }
+
+private:
+    QString m_name;
+    int m_device;
+    qint64 m_memoryBudget;
+    QList<PlanList> m_lists;
+    QList<VideoTier> m_tiers;
+    Photography m_photography;
+    QHash<const AspectRatio *, CamMode> m_image;
+    QHash<const AspectRatio *, CamMode> m_video;
+    QHash<const AspectRatio *, CamMode> m_viewfinder;
+};
+
+#endif // CAMERAPLAN_H
@@ -0,0 +1,136 @@
+#include "camhwtemplate.h"
+
+#include <QFile>
+
+static bool isKeyChar(QChar c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+CamhwTemplate::CamhwTemplate() :
+    m_size(0)
+{
+}
+
+bool CamhwTemplate::load(const QString &filename)
+{
+    QFile file(filename);
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        return false;
+    }
+
+    m_filename = filename;
+    parse(QString::fromUtf8(file.readAll()));
+
+    return true;
+}
+
+void CamhwTemplate::parse(const QString &text)
+{
+    int pos = 0;
+    int literalStart = 0;
+    int line = 1;
+    int literalLine = 1;
+
+    m_tokens.clear();
+    m_size = text.size();
+
+    while (pos < text.size())
+    {
+        if (text.at(pos) == '\n')
+        {
+            line++;
+            pos++;
+            continue;
+        }
+
+        if (text.at(pos) != '@')
+        {
+            pos++;
+            continue;
+        }
+
+        int end = pos + 1;
+        while (end < text.size() && isKeyChar(text.at(end)))
+            end++;
+
+        if (end == pos + 1 || end == text.size() || text.at(end) != '@')
+        {
+            pos++;
+            continue;
+        }
+
+        if (pos > literalStart)
+        {
+            Token literal = { false, literalLine, text.mid(literalStart, pos - literalStart) };
+            m_tokens.append(literal);
+        }
+
+        Token slot = { true, line, text.mid(pos + 1, end - pos - 1) };
+        m_tokens.append(slot);
+
+        pos = end + 1;
+        literalStart = pos;
+        literalLine = line;
+    }
+
+    if (pos > literalStart)
+    {
+        Token literal = { false, literalLine, text.mid(literalStart) };
+        m_tokens.append(literal);
+    }
+}
+
+QString CamhwTemplate::fileName() const
+{
+    return m_filename;
+}
+
+QStringList CamhwTemplate::keys() const
+{
+    QStringList res;
+    int i;
+
+    for (i=0 ; i<m_tokens.size() ; i++)
+    {
+        if (m_tokens.at(i).slot && !res.contains(m_tokens.at(i).text))
+            res.append(m_tokens.at(i).text);
+    }
+
+    return res;
+}
+
+QString CamhwTemplate::render(const QHash<QString, QString> &values, QStringList *unresolved) const
+{
+    QString res;
+    int i;
+
+    res.reserve(m_size);
+
+    for (i=0 ; i<m_tokens.size() ; i++)
+    {
+        const Token &token = m_tokens.at(i);
+
+        if (!token.slot)
+        {
+            res.append(token.text);
+            continue;
+        }
+
+        QHash<QString, QString>::const_iterator value = values.constFind(token.text);
+
+        if (value == values.constEnd() || value.value().isEmpty())
+        {
+            res.append('@').append(token.text).append('@');
+            if (unresolved)
+                unresolved->append(QString("%1 (line %2)").arg(token.text).arg(token.line));
+            continue;
+        }
+
+        res.append(value.value());
+    }
+
+    return res;
+}
@@ -0,0 +1,42 @@
+#ifndef CAMHWTEMPLATE_H
+#define CAMHWTEMPLATE_H
+
+#include <QHash>
+#include <QVector>
+#include <QStringList>
+
+/*
+ * Template with @KEY@ placeholders, parsed once into literal and slot
+ * tokens. KEY consists of upper case letters, digits and underscores;
+ * any other '@' is kept as literal text.
+ */
+class CamhwTemplate
+{
+public:
+    CamhwTemplate();
+
+    bool load(const QString &filename);
+    void parse(const QString &text);
+
+    QString fileName() const;
+    QStringList keys() const;
+
+    // Replaces every slot with its value. Slots without a value, or with
+    // an empty one, are left as they are and reported in unresolved as
+    // "KEY (line N)".
+    QString render(const QHash<QString, QString> &values, QStringList *unresolved = 0) const;
+
+private:
+    struct Token
+    {
+        bool slot;
+        int line;
+        QString text;
+    };
+
+    QString m_filename;
+    QVector<Token> m_tokens;
+    int m_size;
+};
+
+#endif // CAMHWTEMPLATE_H
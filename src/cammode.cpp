@@ -0,0 +1,99 @@
+#include "cammode.h"
+
+// Bits per pixel of the raw formats cameras report
+static const struct
+{
+    const char *format;
+    int bitsPerPixel;
+} formatBits[] = {
+    { "NV12", 12 }, { "NV21", 12 }, { "I420", 12 }, { "YV12", 12 },
+    { "YUY2", 16 }, { "UYVY", 16 }, { "YVYU", 16 }, { "NV16", 16 }, { "RGB16", 16 },
+    { "RGB", 24 }, { "BGR", 24 },
+    { "RGBA", 32 }, { "BGRA", 32 }, { "ARGB", 32 }, { "ABGR", 32 },
+    { "RGBx", 32 }, { "BGRx", 32 }, { "xRGB", 32 }, { "xBGR", 32 }
+};
+
+QString CamMode::resolution() const
+{
+    return QString("%1x%2").arg(width).arg(height);
+}
+
+QString CamMode::toString() const
+{
+    if (!hasFramerate())
+    {
+        return resolution();
+    }
+
+    if (isFramerateRange())
+    {
+        return QString("%1x%2@%3/%4-%5/%6").arg(width).arg(height)
+            .arg(fpsNum).arg(fpsDen)
+            .arg(fpsMaxNum).arg(fpsMaxDen);
+    }
+
+    return QString("%1x%2@%3/%4").arg(width).arg(height).arg(fpsNum).arg(fpsDen);
+}
+
+int CamMode::bitsPerPixel(const QByteArray &format)
+{
+    unsigned i;
+
+    for (i=0 ; i<sizeof(formatBits)/sizeof(formatBits[0]) ; i++)
+    {
+        if (format == formatBits[i].format)
+            return formatBits[i].bitsPerPixel;
+    }
+
+    return 12;
+}
+
+qint64 CamMode::frameSize() const
+{
+    return area() * bitsPerPixel(format) / 8;
+}
+
+int CamMode::expectedBuffers() const
+{
+    // Viewfinder: display queue plus the buffers held by the HAL.
+    // Video: additionally the frames queued for the encoder.
+    // Image: the capture buffers of a burst.
+    switch (kind)
+    {
+    case Viewfinder:
+        return 6;
+    case Video:
+        return 10;
+    case Image:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+CamMode::Kind CamMode::kindForCaps(const QString &whichCaps)
+{
+    if (whichCaps.startsWith("image"))
+        return Image;
+    if (whichCaps.startsWith("video"))
+        return Video;
+    if (whichCaps.startsWith("viewfinder"))
+        return Viewfinder;
+
+    return Unknown;
+}
+
+const char *CamMode::kindName(Kind kind)
+{
+    switch (kind)
+    {
+    case Image:
+        return "image";
+    case Video:
+        return "video";
+    case Viewfinder:
+        return "viewfinder";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef CAMMODE_H
+#define CAMMODE_H
+
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include <QHash>
+
+/*
+ * One mode advertised by the camera: a resolution with its framerate
+ * (fixed or range), pixel format and the caps it was reported in.
+ * A mode without framerate has fpsDen == 0.
+ */
+struct CamMode
+{
+    enum Kind
+    {
+        Unknown,
+        Image,
+        Video,
+        Viewfinder
+    };
+
+    CamMode() :
+        width(0), height(0),
+        fpsNum(0), fpsDen(0), fpsMaxNum(0), fpsMaxDen(0),
+        kind(Unknown)
+    {
+    }
+
+    CamMode(int w, int h, Kind k = Unknown) :
+        width(w), height(h),
+        fpsNum(0), fpsDen(0), fpsMaxNum(0), fpsMaxDen(0),
+        kind(k)
+    {
+    }
+
+    bool isValid() const { return width > 0 && height > 0; }
+    bool hasFramerate() const { return fpsDen != 0 && fpsMaxDen != 0; }
+    bool isFramerateRange() const { return hasFramerate() && (fpsNum != fpsMaxNum || fpsDen != fpsMaxDen); }
+    qint64 area() const { return (qint64)width * height; }
+
+    bool sameResolution(const CamMode &other) const
+    {
+        return width == other.width && height == other.height;
+    }
+
+    bool operator==(const CamMode &other) const
+    {
+        return width == other.width && height == other.height &&
+               fpsNum == other.fpsNum && fpsDen == other.fpsDen &&
+               fpsMaxNum == other.fpsMaxNum && fpsMaxDen == other.fpsMaxDen &&
+               format == other.format && kind == other.kind;
+    }
+
+    // "WxH"
+    QString resolution() const;
+    // "WxH@n/d", "WxH@n/d-n/d" or "WxH" without framerate
+    QString toString() const;
+
+    // Estimated size of one frame in bytes, from the pixel format.
+    // Unknown and compressed formats are assumed to be YUV 4:2:0.
+    qint64 frameSize() const;
+    // Bits per pixel of format, 12 for unknown and compressed formats
+    static int bitsPerPixel(const QByteArray &format);
+    // Buffers a camera pipeline typically keeps queued for this kind
+    int expectedBuffers() const;
+    // Estimated size of the buffer pool, frameSize() * expectedBuffers()
+    qint64 footprint() const { return frameSize() * expectedBuffers(); }
+
+    static Kind kindForCaps(const QString &whichCaps);
+    static const char *kindName(Kind kind);
+
+    int width;
+    int height;
+    int fpsNum;
+    int fpsDen;
+    int fpsMaxNum;
+    int fpsMaxDen;
+    QByteArray format;
+    Kind kind;
+};
+
+Q_DECLARE_TYPEINFO(CamMode, Q_MOVABLE_TYPE);
+
+typedef QVector<CamMode> CamModeList;
+
+inline uint qHash(const CamMode &mode, uint seed = 0)
+{
+    uint h = ::qHash(mode.width, seed) ^ ::qHash(mode.height << 16, seed);
+
+    h ^= ::qHash(mode.fpsNum, seed) * 31 + ::qHash(mode.fpsDen, seed);
+    h ^= (::qHash(mode.fpsMaxNum, seed) * 31 + ::qHash(mode.fpsMaxDen, seed)) << 1;
+
+    return h ^ ::qHash(mode.format, seed) ^ (uint)mode.kind;
+}
+
+#endif // CAMMODE_H
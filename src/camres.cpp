@@ -1,31 +1,219 @@
 #include "camres.h"
 #include <unistd.h>
-#include <math.h>
 #include <QDir>
 #include <QDebug>
-#include <QRect>
+#include <QVector>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QMutexLocker>
+#include <QSharedPointer>
 
 #include <gst/pbutils/encoding-profile.h>
 #include <gst/pbutils/encoding-target.h>
 
+#include "probesession.h"
+#include "capswalker.h"
+#include "timings.h"
+#include "photography.h"
+
+// State of one round of probing, shared with the workers so that a
+// worker stuck in the HAL can outlive the round without touching freed
+// memory.
+struct ProbeRound
+{
+    QList<QPair<QString, int> > cameras;
+    QStringList whichCaps;
+    QVector<int> order;
+    QAtomicInt next;
+    QAtomicInt cancelled;
+    QAtomicInt running;
+    QMutex lock;
+    QElapsedTimer clock;
+    QVector<QList<QPair<QString, QString> > > results;
+    QVector<Photography> photography;
+    QVector<qint64> started;
+    QVector<qint64> elapsed;
+    qint64 setupTotal;
+    int sessions;
+};
+
+class ProbeTask : public QRunnable
+{
+public:
+    ProbeTask(Camres *camres, const QSharedPointer<ProbeRound> &round) :
+        m_camres(camres), m_round(round)
+    {
+        m_round->running.ref();
+    }
+
+    void run()
+    {
+        // Each worker gets its own main context so that sources attached by
+        // the pipeline elements do not end up on the default context.
+        GMainContext *context = g_main_context_new();
+        g_main_context_push_thread_default(context);
+
+        {
+            ProbeSession session(m_camres, m_camres->fastProbe());
+
+            session.setTimeout(m_camres->cameraTimeout());
+            session.setCancelFlag(&m_round->cancelled);
+
+            int n;
+            while (!m_round->cancelled.load() &&
+                   (n = m_round->next.fetchAndAddOrdered(1)) < m_round->order.size())
+            {
+                int i = m_round->order.at(n);
+                PhaseTimer phase("probe", m_round->cameras.at(i).second);
+
+                {
+                    QMutexLocker locker(&m_round->lock);
+                    m_round->started[i] = m_round->clock.elapsed();
+                }
+
+                Photography photography;
+                QList<QPair<QString, QString> > caps = session.getCaps(m_round->cameras.at(i).second,
+                                                                       m_round->whichCaps, &photography);
+
+                QMutexLocker locker(&m_round->lock);
+                if (!m_round->cancelled.load())
+                {
+                    m_round->results[i] = caps;
+                    m_round->photography[i] = photography;
+                    m_round->elapsed[i] = m_round->clock.elapsed() - m_round->started.at(i);
+                }
+            }
+
+            QMutexLocker locker(&m_round->lock);
+            m_round->setupTotal += session.setupTime();
+            m_round->sessions++;
+        }
+
+        g_main_context_pop_thread_default(context);
+        g_main_context_unref(context);
+
+        m_round->running.deref();
+    }
+
+private:
+    Camres *m_camres;
+    QSharedPointer<ProbeRound> m_round;
+};
+
 Camres::Camres(QObject *parent) :
-    QObject(parent)
+    QObject(parent),
+    m_profile(NULL),
+    m_profileTime(0),
+    m_fastProbe(true),
+    m_sourceElement("droidcamsrc"),
+    m_cameraTimeout(DefaultCameraTimeoutMs),
+    m_probeTimeout(DefaultProbeTimeoutMs),
+    m_abandoned(false)
 {
+    PhaseTimer phase("gst-init");
+
     gst_init(0, 0);
 }
 
 Camres::~Camres()
 {
+    if (m_profile)
+        gst_encoding_profile_unref(m_profile);
+}
+
+void Camres::setSourceElement(const QByteArray &factoryName)
+{
+    m_sourceElement = factoryName;
+}
+
+QByteArray Camres::sourceElement() const
+{
+    return m_sourceElement;
+}
+
+void Camres::setFastProbe(bool fastProbe)
+{
+    m_fastProbe = fastProbe;
+}
+
+bool Camres::fastProbe() const
+{
+    return m_fastProbe;
+}
+
+void Camres::setCameraTimeout(int timeoutMs)
+{
+    m_cameraTimeout = timeoutMs;
+}
+
+int Camres::cameraTimeout() const
+{
+    return m_cameraTimeout;
+}
+
+void Camres::setProbeTimeout(int timeoutMs)
+{
+    m_probeTimeout = timeoutMs;
+}
+
+int Camres::probeTimeout() const
+{
+    return m_probeTimeout;
+}
+
+bool Camres::abandoned() const
+{
+    return m_abandoned;
+}
+
+GstEncodingProfile *Camres::profile()
+{
+    QMutexLocker locker(&m_profileLock);
+
+    if (m_profile)
+    {
+        return m_profile;
+    }
+
+    PhaseTimer phase("load-profile");
+    QElapsedTimer timer;
+    timer.start();
+
+    GError *error = NULL;
+    GstEncodingTarget *target = gst_encoding_target_load_from_file("/usr/share/droid-camres/video.gep", &error);
+
+    if (!target)
+    {
+        qCritical("Camres error: Failed to load encoding target: %s", qPrintable(error->message));
+        g_error_free(error);
+        return NULL;
+    }
+
+    m_profile = gst_encoding_target_get_profile(target, "video-profile");
+    gst_encoding_target_unref(target);
+
+    if (!m_profile)
+    {
+        qCritical("Camres error: Failed to load encoding profile.");
+        return NULL;
+    }
+
+    m_profileTime = timer.elapsed();
+
+    return m_profile;
 }
 
 QList<QPair<QString, int> > Camres::getCameras()
 {
+    PhaseTimer phase("get-cameras");
     QList<QPair<QString, int> > res;
 
-    GstElement *elem = gst_element_factory_make("droidcamsrc", NULL);
+    GstElement *elem = gst_element_factory_make(m_sourceElement.constData(), NULL);
     if (!elem)
     {
-        qCritical("Camres error: Failed to create an instance of droidcamsrc.");
+        qCritical("Camres error: Failed to create an instance of %s.", m_sourceElement.constData());
         return res;
     }
 
@@ -62,231 +250,247 @@ QList<QPair<QString, int> > Camres::getCameras()
 }
 
 
-QList<QPair<QString, QStringList> > Camres::getResolutions(int cam, QStringList whichCaps)
+QList<QPair<QString, CamModeList> > Camres::getResolutions(int cam, QStringList whichCaps)
+{
+    return parse(getCaps(cam, whichCaps));
+}
+
+QList<QPair<QString, QString> > Camres::getCaps(int cam, const QStringList &whichCaps, Photography *photography)
 {
-    QList<QPair<QString, QStringList> > res;
+    ProbeSession session(this, m_fastProbe);
 
-    GstElement *cameraBin = gst_element_factory_make("camerabin", NULL);
+    session.setTimeout(m_cameraTimeout);
 
-    if (!cameraBin)
-    {
-        qCritical("Camres error: Failed to create camerabin.");
-        return res;
-    }
+    return session.getCaps(cam, whichCaps, photography);
+}
 
-    GstElement *videoSource = gst_element_factory_make("droidcamsrc", NULL);
-    if (!videoSource)
-    {
-        qCritical("Camres error: Failed to create videoSource.");
-        gst_object_unref(cameraBin);
-        return res;
-    }
+// Runs one round of workers until every camera is done or stuck, or
+// until budgetMs has passed. A worker blocked in the HAL cannot be
+// interrupted, so it is left behind and its pool is leaked.
+void Camres::runRound(const QSharedPointer<ProbeRound> &round, int jobs, qint64 budgetMs)
+{
+    QThreadPool *pool = new QThreadPool;
+    QVector<bool> stuck(round->cameras.size(), false);
+    int i;
 
-    g_object_set(cameraBin, "camera-source", videoSource, NULL);
-    g_object_set(videoSource, "camera-device", cam, NULL);
+    round->clock.start();
+    pool->setMaxThreadCount(jobs);
 
-    GstElement *fakeviewfinder = gst_element_factory_make("fakesink", NULL);
-    if (!fakeviewfinder)
+    for (i=0 ; i<jobs ; i++)
+        pool->start(new ProbeTask(this, round));
+
+    while (!pool->waitForDone(20))
     {
+        int stuckCount = 0;
+        int pending = 0;
+        int unclaimed = qMax(0, round->order.size() - round->next.load());
+
         {
-            qCritical("Camres error: Failed to create fake viewfinder.");
-            gst_object_unref(videoSource);
-            gst_object_unref(cameraBin);
-            return res;
-        }
-    }
+            QMutexLocker locker(&round->lock);
+            qint64 now = round->clock.elapsed();
 
-    g_object_set(cameraBin, "viewfinder-sink", fakeviewfinder, NULL);
+            for (i=0 ; i<round->order.size() ; i++)
+            {
+                int c = round->order.at(i);
 
-    GError *error = NULL;
-    GstEncodingTarget *target = gst_encoding_target_load_from_file("/usr/share/droid-camres/video.gep", &error);
+                if (round->started.at(c) < 0 || round->elapsed.at(c) >= 0)
+                    continue;
 
-    if (!target)
-    {
-        qCritical("Camres error: Failed to load encoding target: %s", qPrintable(error->message));
-        g_error_free(error);
-        gst_object_unref(fakeviewfinder);
-        gst_object_unref(videoSource);
-        gst_object_unref(cameraBin);
-        return res;
-    }
+                pending++;
 
-    GstEncodingProfile *profile = gst_encoding_target_get_profile(target, "video-profile");
-    if (!profile)
-    {
-        qCritical("Camres error: Failed to load encoding profile.");
-        gst_object_unref(fakeviewfinder);
-        gst_object_unref(videoSource);
-        gst_object_unref(cameraBin);
-        gst_encoding_target_unref(target);
-        return res;
-    }
+                // The session gives up by itself at the camera timeout
+                // unless it is blocked in the HAL, allow it a second more
+                if (!stuck.at(c) && m_cameraTimeout > 0 && now - round->started.at(c) > m_cameraTimeout + 1000)
+                {
+                    qWarning("Camres warning: %s did not answer within %d ms, giving up on it.",
+                             qPrintable(round->cameras.at(c).first), m_cameraTimeout);
+                    stuck[c] = true;
+                }
 
-    gst_encoding_target_unref(target);
+                if (stuck.at(c))
+                    stuckCount++;
+            }
+        }
 
-    g_object_set(cameraBin, "video-profile", profile, NULL);
+        // Only the stuck cameras are left, the others are tearing down
+        if (unclaimed == 0 && stuckCount > 0 && pending == stuckCount)
+            break;
 
-    if (gst_element_set_state (GST_ELEMENT (cameraBin), GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
-    {
-        qCritical("Camres error: Failed to start playback.");
-        gst_object_unref(fakeviewfinder);
-        gst_object_unref(videoSource);
-        gst_object_unref(cameraBin);
-        return res;
-    }
+        // Keep jobs workers going past the stuck ones
+        if (unclaimed > 0 && round->running.load() - stuckCount < jobs)
+        {
+            pool->setMaxThreadCount(pool->maxThreadCount() + 1);
+            pool->start(new ProbeTask(this, round));
+        }
 
-    GstCaps *caps = NULL;
+        if (budgetMs >= 0 && round->clock.elapsed() >= budgetMs)
+        {
+            qWarning("Camres warning: Probe timeout of %d ms reached, using partial results.", m_probeTimeout);
+            break;
+        }
+    }
 
-    int i;
+    round->cancelled.store(1);
 
-    for (i=0 ; i<whichCaps.size() ; i++)
+    if (pool->waitForDone(1000))
     {
-        g_object_get(cameraBin, whichCaps.at(i).toLatin1().constData(), &caps, NULL);
-        res.append(qMakePair<QString, QStringList>(whichCaps.at(i), parse(caps)));
+        delete pool;
+    }
+    else
+    {
+        qWarning("Camres warning: Abandoning %d probe threads stuck in the camera HAL.", round->running.load());
+        m_abandoned = true;
     }
-
-    gst_caps_unref(caps);
-    gst_element_set_state (GST_ELEMENT (cameraBin), GST_STATE_NULL);
-    gst_object_unref(fakeviewfinder);
-    gst_object_unref(videoSource);
-    gst_object_unref(cameraBin);
-
-    return res;
 }
 
-QStringList Camres::parse(GstCaps *caps)
+QList<QList<QPair<QString, QString> > > Camres::getAllCaps(const QList<QPair<QString, int> > &cameras,
+                                                          const QStringList &whichCaps,
+                                                          int jobs,
+                                                          QList<Photography> *photography)
 {
-    QStringList res;
-    QString tmp;
+    QVector<QList<QPair<QString, QString> > > res(cameras.size());
+    QVector<Photography> photographyRes(cameras.size());
+    QVector<qint64> elapsed(cameras.size(), -1);
+    QVector<int> order;
+    QElapsedTimer wallClock;
+    qint64 total = 0;
+    qint64 setupTotal = 0;
+    int sessions = 0;
+    int round;
+    int i;
 
-    if (!caps)
+    jobs = qBound(1, jobs, qMax(1, cameras.size()));
+
+    wallClock.start();
+
+    for (i=0 ; i<cameras.size() ; i++)
     {
-        return res;
+        qInfo("Searching resolutions for %s...", qPrintable(cameras.at(i).first));
+        order.append(i);
     }
 
-    for (guint x = 0; x < gst_caps_get_size(caps); x++)
+    // The HAL may refuse to open a camera while another one is open, so
+    // cameras that fail quickly in parallel are retried on their own.
+    for (round=0 ; round<2 && !order.isEmpty() ; round++)
     {
-        const GstStructure *s = gst_caps_get_structure(caps, x);
-        const GValue *width = gst_structure_get_value(s, "width");
-        const GValue *height = gst_structure_get_value(s, "height");
-        const GValue *fps = gst_structure_get_value(s, "framerate");
+        QSharedPointer<ProbeRound> r(new ProbeRound);
+        qint64 budget = m_probeTimeout > 0 ? qMax((qint64)0, m_probeTimeout - wallClock.elapsed()) : -1;
 
-        if (!width || !height)
-        {
-            continue;
-        }
+        if (budget == 0)
+            break;
+
+        r->cameras = cameras;
+        r->whichCaps = whichCaps;
+        r->order = order;
+        r->results = res;
+        r->photography = photographyRes;
+        r->started.fill(-1, cameras.size());
+        r->elapsed.fill(-1, cameras.size());
+        r->setupTotal = 0;
+        r->sessions = 0;
 
-        bool width_is_list = GST_VALUE_HOLDS_LIST(width) ? true : false;
-        bool height_is_list = GST_VALUE_HOLDS_LIST(height) ? true : false;
-        bool fps_is_list = GST_VALUE_HOLDS_LIST(fps) ? true : false;
+        runRound(r, round == 0 ? jobs : 1, budget);
 
-        for (guint wc = 0; wc == 0 || (width_is_list && wc < gst_value_list_get_size(width)); wc++)
+        QMutexLocker locker(&r->lock);
+        order.clear();
+
+        for (i=0 ; i<r->order.size() ; i++)
         {
-            int w = g_value_get_int(width_is_list?gst_value_list_get_value(width, wc): width);
-            for (guint hc = 0; hc == 0 || (height_is_list && hc < gst_value_list_get_size(height)); hc++)
+            int c = r->order.at(i);
+
+            res[c] = r->results.at(c);
+            photographyRes[c] = r->photography.at(c);
+            elapsed[c] = r->elapsed.at(c);
+
+            if (round == 0 && jobs > 1 && res.at(c).isEmpty() && elapsed.at(c) >= 0 &&
+                (m_cameraTimeout <= 0 || elapsed.at(c) < m_cameraTimeout))
             {
-                int h = g_value_get_int(height_is_list?gst_value_list_get_value(height, hc): height);
-                for (guint fc = 0; fc == 0 || (fps_is_list && fc < gst_value_list_get_size(fps)); fc++)
-                {
-                    const GValue *fps_val = fps_is_list?gst_value_list_get_value(fps, fc): fps;
-                    if (GST_VALUE_HOLDS_FRACTION(fps_val))
-                    {
-                        tmp = QString("%1x%2@%3/%4").arg(w).arg(h)
-                            .arg(gst_value_get_fraction_numerator(fps_val))
-                            .arg(gst_value_get_fraction_denominator(fps_val));
-                    }
-                    else if (GST_VALUE_HOLDS_FRACTION_RANGE(fps_val))
-                    {
-                        const GValue *fps_min = gst_value_get_fraction_range_min(fps_val);
-                        const GValue *fps_max = gst_value_get_fraction_range_max(fps_val);
-                        tmp = QString("%1x%2@%3/%4-%5/%6").arg(w).arg(h)
-                            .arg(gst_value_get_fraction_numerator(fps_min))
-                            .arg(gst_value_get_fraction_denominator(fps_min))
-                            .arg(gst_value_get_fraction_numerator(fps_max))
-                            .arg(gst_value_get_fraction_denominator(fps_max));
-                    }
-                    else
-                    {
-                        qWarning("Camres error: Unknown framerate type");
-                        tmp = QString("%1x%2").arg(w).arg(h);
-                    }
-                    if (!res.contains(tmp))
-                        res.append(tmp);
-                }
+                qWarning("Camres warning: Parallel probe failed for %s, retrying serially.", qPrintable(cameras.at(c).first));
+                order.append(c);
             }
         }
+
+        setupTotal += r->setupTotal;
+        sessions += r->sessions;
     }
 
-    return res;
+    for (i=0 ; i<cameras.size() ; i++)
+    {
+        if (elapsed.at(i) < 0)
+        {
+            qInfo("Camres: Probing %s timed out", qPrintable(cameras.at(i).first));
+            continue;
+        }
+
+        qInfo("Camres: Probed %s in %lld ms", qPrintable(cameras.at(i).first), elapsed.at(i));
+        total += elapsed.at(i);
+    }
+
+    // Not measured: a fresh session per camera would set up a pipeline and
+    // load the profile again for every camera, estimated from the averages
+    qInfo("Camres: Loaded encoding profile in %lld ms, set up %d probe sessions in %lld ms "
+          "(estimate for one session per camera: %lld ms)",
+          m_profileTime, sessions, setupTotal,
+          sessions == 0 ? 0 : (setupTotal / sessions + m_profileTime) * cameras.size());
+
+    qInfo("Camres: Probed %d cameras in %lld ms wall clock, %lld ms summed (%d jobs)",
+          cameras.size(), wallClock.elapsed(), total, jobs);
+
+    if (photography)
+        *photography = photographyRes.toList();
+
+    return res.toList();
 }
 
-QString Camres::aspectRatioForResolution(const QString& size)
+QList<QPair<QString, CamModeList> > Camres::parse(const QList<QPair<QString, QString> > &caps)
 {
-    static QMap<float, QString> ratios;
-    int width, height;
-
-    width = size.split(QRegExp("[x@]")).at(0).toInt();
-    height = size.split(QRegExp("[x@]")).at(1).toInt();
+    QList<QPair<QString, CamModeList> > res;
+    int i;
 
-    if (ratios.isEmpty())
+    for (i=0 ; i<caps.size() ; i++)
     {
-        ratios[0.7] = "3:4";
-        ratios[0.8] = "4:5";
-        ratios[1.0] = "1:1";
-        ratios[1.2] = "5:4";
-        ratios[1.3] = "4:3";
-        ratios[1.5] = "3:2";
-        ratios[1.6] = "16:10";
-        ratios[1.7] = "16:9";
-        ratios[1.8] = "9:5";
-    }
+        GstCaps *c = gst_caps_from_string(caps.at(i).second.toLatin1().constData());
 
-    float r = (width * 1.0) / height;
-    r = floor(r * 10) / 10.0;
+        if (!c && !caps.at(i).second.isEmpty())
+            qWarning("Camres warning: Could not parse %s: %s", qPrintable(caps.at(i).first), qPrintable(caps.at(i).second));
 
-    for (QMap<float, QString>::const_iterator iter = ratios.constBegin(); iter != ratios.constEnd(); ++iter)
-    {
-        if (qFuzzyCompare (r, iter.key()))
-        {
-            return iter.value();
-        }
-    }
+        res.append(qMakePair<QString, CamModeList>(caps.at(i).first, parse(c, CamMode::kindForCaps(caps.at(i).first))));
 
-    qWarning("Camres error: Could not find aspect ratio for %dx%d", width, height);
+        if (c)
+            gst_caps_unref(c);
+    }
 
-    return QString("?:?");
+    return res;
 }
 
-QString Camres::findBestViewFinderForResolution(const QString& size, const QList<QPair<QString, QStringList> > &resolutions, const QRect &screenGeometry)
+QList<QList<QPair<QString, CamModeList> > > Camres::parse(const QList<QList<QPair<QString, QString> > > &caps)
 {
-    int width, height;
+    QList<QList<QPair<QString, CamModeList> > > res;
+    int i;
 
-    int j, m;
+    for (i=0 ; i<caps.size() ; i++)
+        res.append(parse(caps.at(i)));
 
-    for (j=0 ; j<resolutions.size(); j++)
-    {
-        if (resolutions.at(j).first.startsWith("viewfinder"))
-        {
-            for (m=0 ; m<resolutions.at(j).second.size(); m++)
-            {
-                width = resolutions.at(j).second.at(m).split(QRegExp("[x@]")).at(0).toInt();
-                height = resolutions.at(j).second.at(m).split(QRegExp("[x@]")).at(1).toInt();
+    return res;
+}
 
-                if (qMin(screenGeometry.height(), screenGeometry.width()) >=
-                    qMin(width, height) &&
-                    qMax(screenGeometry.height(), screenGeometry.width()) >=
-                    qMax(width, height))
-                {
-                    if (Camres::aspectRatioForResolution(resolutions.at(j).second.at(m)).compare(Camres::aspectRatioForResolution(size)) == 0)
-                    {
-                        return resolutions.at(j).second.at(m).split('@').first();
-                    }
-                }
-            }
-        }
+QString Camres::capsToString(GstCaps *caps)
+{
+    QString res;
+
+    if (!caps)
+    {
+        return res;
     }
 
-    qCritical("Camres error: Could not find viewfinder for %s", qPrintable(size));
+    gchar *str = gst_caps_to_string(caps);
+    res = QString::fromLatin1(str);
+    g_free(str);
 
-    return QString("?:?");
+    return res;
+}
+
+CamModeList Camres::parse(GstCaps *caps, CamMode::Kind kind)
+{
+    return CapsWalker::modes(caps, kind);
 }
@@ -1,24 +1,68 @@
 #ifndef CAMRES_H
 #define CAMRES_H
 #include <QObject>
+#include <QMutex>
+#include <QSharedPointer>
 
 #include <gst/gst.h>
+#include <gst/pbutils/encoding-profile.h>
+
+#include "cammode.h"
+
+struct ProbeRound;
+class Photography;
 
 class Q_DECL_EXPORT Camres : public QObject
 {
     Q_OBJECT
 
 public:
+    static const int DefaultCameraTimeoutMs = 15000;
+    static const int DefaultProbeTimeoutMs = 60000;
+
     explicit Camres(QObject *parent = 0);
     virtual ~Camres();
 
     QList<QPair<QString, int> > getCameras();
-    QList<QPair<QString, QStringList> > getResolutions(int cam, QStringList whichCaps);
-    static QString aspectRatioForResolution(const QString& size);
-    static QString findBestViewFinderForResolution(const QString& size, const QList<QPair<QString, QStringList> > &resolutions, const QRect &screenGeometry);
+    QList<QPair<QString, CamModeList> > getResolutions(int cam, QStringList whichCaps);
+    // The photography values of the cameras are returned in photography,
+    // if given, in the order of the caps
+    QList<QPair<QString, QString> > getCaps(int cam, const QStringList &whichCaps, Photography *photography = 0);
+    QList<QList<QPair<QString, QString> > > getAllCaps(const QList<QPair<QString, int> > &cameras,
+                                                       const QStringList &whichCaps,
+                                                       int jobs,
+                                                       QList<Photography> *photography = 0);
+    static CamModeList parse(GstCaps *caps, CamMode::Kind kind);
+    static QList<QPair<QString, CamModeList> > parse(const QList<QPair<QString, QString> > &caps);
+    static QList<QList<QPair<QString, CamModeList> > > parse(const QList<QList<QPair<QString, QString> > > &caps);
+    static QString capsToString(GstCaps *caps);
+
+    void setSourceElement(const QByteArray &factoryName);
+    QByteArray sourceElement() const;
+    void setFastProbe(bool fastProbe);
+    bool fastProbe() const;
+    // Time allowed for probing one camera, 0 for no limit
+    void setCameraTimeout(int timeoutMs);
+    int cameraTimeout() const;
+    // Hard bound on getAllCaps() as a whole, 0 for no limit
+    void setProbeTimeout(int timeoutMs);
+    int probeTimeout() const;
+    // True once a probe thread stuck in the HAL has been left behind.
+    // The process then has to leave with _exit().
+    bool abandoned() const;
+    GstEncodingProfile *profile();
 
 private:
-    QStringList parse(GstCaps *caps);
+    void runRound(const QSharedPointer<ProbeRound> &round, int jobs, qint64 budgetMs);
+
+    QMutex m_profileLock;
+    GstEncodingProfile *m_profile;
+    qint64 m_profileTime;
+    bool m_fastProbe;
+    QByteArray m_sourceElement;
+    int m_cameraTimeout;
+    int m_probeTimeout;
+    bool m_abandoned;
 };
 
 
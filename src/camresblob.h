@@ -0,0 +1,156 @@
+#ifndef CAMRESBLOB_H
+#define CAMRESBLOB_H
+
+/*
+ * Reader for the binary capability blob written by droid-camres -b.
+ *
+ * The blob holds the same cameras, modes, viewfinder pairings and aspect
+ * ratios as the JSON, in a fixed layout that can be mapped and used in
+ * place, without parsing or allocating. This header depends on nothing
+ * but the C library and can be copied into the consumer.
+ *
+ * Layout, all fields are little-endian 32-bit integers and all offsets
+ * are in bytes from the start of the file:
+ *
+ *   CamresBlobHeader
+ *   CamresBlobCamera[camera_count]  at cameras
+ *   CamresBlobMode[mode_count]      at modes
+ *   CamresBlobAspect[aspect_count]  at aspects
+ *   NUL-terminated strings          at strings, strings_size bytes
+ *
+ * Each camera owns mode_count consecutive modes from first_mode: first
+ * the offered image and video modes, as in the JSON, then the
+ * viewfinder modes they are paired with. A new version is only needed
+ * for incompatible changes; fields are never reused.
+ *
+ * Usage:
+ *
+ *   const CamresBlobHeader *blob = camres_blob_open(data, size);
+ *   if (blob)
+ *       for (i = 0; i < blob->camera_count; i++)
+ *           puts(camres_blob_string(blob, camres_blob_camera(blob, i)->name));
+ *
+ * camres_blob_open() checks the header and that every section is within
+ * the data. The indices and string offsets inside the sections are
+ * checked by droid-camres --verify-blob when the blob is generated.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The camres blob can only be mapped on little-endian hosts"
+#endif
+
+#define CAMRES_BLOB_MAGIC "CAMRESB"
+#define CAMRES_BLOB_VERSION 1
+#define CAMRES_BLOB_NONE 0xffffffffu
+
+/* Values of CamresBlobMode.kind */
+#define CAMRES_BLOB_IMAGE 1
+#define CAMRES_BLOB_VIDEO 2
+#define CAMRES_BLOB_VIEWFINDER 3
+
+typedef struct
+{
+    char magic[8];              /* CAMRES_BLOB_MAGIC, NUL-terminated */
+    uint32_t version;           /* CAMRES_BLOB_VERSION */
+    uint32_t size;              /* of the whole blob */
+    uint32_t camera_count;
+    uint32_t cameras;
+    uint32_t mode_count;
+    uint32_t modes;
+    uint32_t aspect_count;
+    uint32_t aspects;
+    uint32_t strings_size;
+    uint32_t strings;
+} CamresBlobHeader;
+
+typedef struct
+{
+    uint32_t name;              /* string */
+    int32_t device;             /* camera-device of droidcamsrc */
+    uint32_t first_mode;
+    uint32_t mode_count;
+} CamresBlobCamera;
+
+typedef struct
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t fps_num;           /* top framerate, fps_den is 0 without one */
+    uint32_t fps_den;
+    uint32_t kind;              /* CAMRES_BLOB_IMAGE, _VIDEO or _VIEWFINDER */
+    uint32_t aspect;            /* index of the aspect ratio, or CAMRES_BLOB_NONE */
+    uint32_t viewfinder;        /* index of the paired viewfinder mode, or CAMRES_BLOB_NONE */
+} CamresBlobMode;
+
+typedef struct
+{
+    uint32_t num;
+    uint32_t den;
+    uint32_t name;              /* string, e.g. "16:9" */
+} CamresBlobAspect;
+
+#ifdef __cplusplus
+static_assert(sizeof(CamresBlobHeader) == 48, "unexpected CamresBlobHeader layout");
+static_assert(sizeof(CamresBlobCamera) == 16, "unexpected CamresBlobCamera layout");
+static_assert(sizeof(CamresBlobMode) == 28, "unexpected CamresBlobMode layout");
+static_assert(sizeof(CamresBlobAspect) == 12, "unexpected CamresBlobAspect layout");
+#endif
+
+static inline int camres_blob_section_fits(uint32_t offset, uint32_t count, uint32_t entry, size_t size)
+{
+    return offset % 4 == 0 && offset <= size && (uint64_t)count * entry <= size - offset;
+}
+
+/* The header of the blob in data, or NULL if it is not a valid blob */
+static inline const CamresBlobHeader *camres_blob_open(const void *data, size_t size)
+{
+    const CamresBlobHeader *header = (const CamresBlobHeader *)data;
+
+    if (!data || ((uintptr_t)data) % 4 != 0 || size < sizeof(CamresBlobHeader))
+        return NULL;
+
+    if (memcmp(header->magic, CAMRES_BLOB_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CAMRES_BLOB_VERSION || header->size != size)
+        return NULL;
+
+    if (!camres_blob_section_fits(header->cameras, header->camera_count, sizeof(CamresBlobCamera), size) ||
+        !camres_blob_section_fits(header->modes, header->mode_count, sizeof(CamresBlobMode), size) ||
+        !camres_blob_section_fits(header->aspects, header->aspect_count, sizeof(CamresBlobAspect), size) ||
+        !camres_blob_section_fits(header->strings, header->strings_size, 1, size))
+        return NULL;
+
+    /* Every string ends within the table */
+    if (header->strings_size == 0 || ((const char *)data)[header->strings + header->strings_size - 1] != '\0')
+        return NULL;
+
+    return header;
+}
+
+static inline const CamresBlobCamera *camres_blob_camera(const CamresBlobHeader *blob, uint32_t i)
+{
+    return i < blob->camera_count ?
+           (const CamresBlobCamera *)((const char *)blob + blob->cameras) + i : NULL;
+}
+
+static inline const CamresBlobMode *camres_blob_mode(const CamresBlobHeader *blob, uint32_t i)
+{
+    return i < blob->mode_count ?
+           (const CamresBlobMode *)((const char *)blob + blob->modes) + i : NULL;
+}
+
+static inline const CamresBlobAspect *camres_blob_aspect(const CamresBlobHeader *blob, uint32_t i)
+{
+    return i < blob->aspect_count ?
+           (const CamresBlobAspect *)((const char *)blob + blob->aspects) + i : NULL;
+}
+
+static inline const char *camres_blob_string(const CamresBlobHeader *blob, uint32_t offset)
+{
+    return offset < blob->strings_size ? (const char *)blob + blob->strings + offset : NULL;
+}
+
+#endif /* CAMRESBLOB_H */
@@ -0,0 +1,293 @@
+#include "capabilityblob.h"
+#include "camresblob.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+
+static_assert(CamMode::Image == CAMRES_BLOB_IMAGE && CamMode::Video == CAMRES_BLOB_VIDEO &&
+              CamMode::Viewfinder == CAMRES_BLOB_VIEWFINDER, "mode kinds are stored as they are");
+
+// Collects the strings of the blob, each stored once
+class StringTable
+{
+public:
+    quint32 add(const QByteArray &string)
+    {
+        QHash<QByteArray, quint32>::const_iterator it = m_offsets.constFind(string);
+
+        if (it != m_offsets.constEnd())
+            return it.value();
+
+        quint32 offset = m_data.size();
+        m_data.append(string);
+        m_data.append('\0');
+        m_offsets.insert(string, offset);
+
+        return offset;
+    }
+
+    const QByteArray &data() const { return m_data; }
+
+private:
+    QByteArray m_data;
+    QHash<QByteArray, quint32> m_offsets;
+};
+
+struct BlobMode
+{
+    CamMode mode;
+    const AspectRatio *aspect;
+    quint32 viewfinder;
+};
+
+static quint32 aspectIndex(QList<const AspectRatio *> &aspects, const AspectRatio *aspect)
+{
+    if (!aspect->isValid())
+    {
+        return CAMRES_BLOB_NONE;
+    }
+
+    if (!aspects.contains(aspect))
+        aspects.append(aspect);
+
+    return aspects.indexOf(aspect);
+}
+
+QByteArray CapabilityBlob::build(const QList<CameraPlan> &plans)
+{
+    QList<const CameraPlan *> cameras;
+    QList<quint32> firstModes;
+    QList<quint32> modeCounts;
+    QList<BlobMode> modes;
+    QList<const AspectRatio *> aspects;
+    StringTable strings;
+    int i, j, m;
+
+    for (i=0 ; i<plans.size() ; i++)
+    {
+        const CameraPlan &plan = plans.at(i);
+        CamModeList viewfinders;
+        int first = modes.size();
+        int captures;
+
+        if (plan.isEmpty())
+            continue;
+
+        // The offered capture modes in the order of the JSON
+        for (j=0 ; j<plan.lists().size() ; j++)
+        {
+            const PlanList &list = plan.lists().at(j);
+
+            if (list.kind == CamMode::Viewfinder)
+                continue;
+
+            for (m=0 ; m<list.offered.size() ; m++)
+            {
+                const PlanMode &planned = list.offered.at(m);
+                BlobMode mode;
+                int vf = -1;
+
+                if (planned.viewfinder.isValid())
+                {
+                    for (vf=0 ; vf<viewfinders.size() && !viewfinders.at(vf).sameResolution(planned.viewfinder) ; vf++)
+                        ;
+                    if (vf == viewfinders.size())
+                        viewfinders.append(planned.viewfinder);
+                }
+
+                mode.mode = planned.mode;
+                mode.aspect = planned.aspect;
+                // Fixed up below, once the number of capture modes is known
+                mode.viewfinder = vf < 0 ? CAMRES_BLOB_NONE : vf;
+                modes.append(mode);
+            }
+        }
+
+        captures = modes.size() - first;
+
+        for (m=first ; m<modes.size() ; m++)
+        {
+            if (modes.at(m).viewfinder != CAMRES_BLOB_NONE)
+                modes[m].viewfinder += first + captures;
+        }
+
+        for (m=0 ; m<viewfinders.size() ; m++)
+        {
+            BlobMode mode;
+
+            mode.mode = viewfinders.at(m);
+            mode.mode.kind = CamMode::Viewfinder;
+            mode.aspect = &AspectRatio::classify(viewfinders.at(m));
+            mode.viewfinder = CAMRES_BLOB_NONE;
+            modes.append(mode);
+        }
+
+        cameras.append(&plan);
+        firstModes.append(first);
+        modeCounts.append(modes.size() - first);
+    }
+
+    QByteArray res;
+    QDataStream out(&res, QIODevice::WriteOnly);
+    QList<quint32> modeAspects;
+
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    // The aspect table and the strings have to be complete before the
+    // header can be written
+    for (m=0 ; m<modes.size() ; m++)
+        modeAspects.append(aspectIndex(aspects, modes.at(m).aspect));
+
+    QList<quint32> cameraNames;
+    QList<quint32> aspectNames;
+
+    // Offset 0 is the empty string, so the table is never empty
+    strings.add(QByteArray());
+
+    for (i=0 ; i<cameras.size() ; i++)
+        cameraNames.append(strings.add(cameras.at(i)->name().toUtf8()));
+    for (i=0 ; i<aspects.size() ; i++)
+        aspectNames.append(strings.add(aspects.at(i)->name));
+
+    quint32 cameraOffset = sizeof(CamresBlobHeader);
+    quint32 modeOffset = cameraOffset + cameras.size() * sizeof(CamresBlobCamera);
+    quint32 aspectOffset = modeOffset + modes.size() * sizeof(CamresBlobMode);
+    quint32 stringOffset = aspectOffset + aspects.size() * sizeof(CamresBlobAspect);
+
+    out.writeRawData(CAMRES_BLOB_MAGIC, sizeof(((CamresBlobHeader *)0)->magic));
+    out << (quint32)CAMRES_BLOB_VERSION
+        << (quint32)(stringOffset + strings.data().size())
+        << (quint32)cameras.size() << cameraOffset
+        << (quint32)modes.size() << modeOffset
+        << (quint32)aspects.size() << aspectOffset
+        << (quint32)strings.data().size() << stringOffset;
+
+    for (i=0 ; i<cameras.size() ; i++)
+        out << cameraNames.at(i) << (qint32)cameras.at(i)->device() << firstModes.at(i) << modeCounts.at(i);
+
+    for (m=0 ; m<modes.size() ; m++)
+    {
+        const CamMode &mode = modes.at(m).mode;
+
+        out << (quint32)mode.width << (quint32)mode.height;
+        if (mode.hasFramerate())
+            out << (quint32)mode.fpsMaxNum << (quint32)mode.fpsMaxDen;
+        else
+            out << (quint32)0 << (quint32)0;
+        out << (quint32)mode.kind << modeAspects.at(m) << modes.at(m).viewfinder;
+    }
+
+    for (i=0 ; i<aspects.size() ; i++)
+        out << (quint32)aspects.at(i)->num << (quint32)aspects.at(i)->den << aspectNames.at(i);
+
+    out.writeRawData(strings.data().constData(), strings.data().size());
+
+    return res;
+}
+
+static QString modeString(const CamresBlobMode *mode)
+{
+    QString res = QString("%1x%2").arg(mode->width).arg(mode->height);
+
+    if (mode->fps_den)
+        res += QString("@%1/%2").arg(mode->fps_num).arg(mode->fps_den);
+
+    return res;
+}
+
+bool CapabilityBlob::verify(const QString &filename)
+{
+    QFile file(filename);
+    uint32_t i, m;
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qCritical("Camres error: Could not open %s: %s", qPrintable(filename), qPrintable(file.errorString()));
+        return false;
+    }
+
+    qint64 size = file.size();
+    uchar *data = size > 0 ? file.map(0, size) : NULL;
+    const CamresBlobHeader *blob = data ? camres_blob_open(data, size) : NULL;
+
+    if (!blob)
+    {
+        qCritical("Camres error: %s is not a capability blob of version %d.", qPrintable(filename), CAMRES_BLOB_VERSION);
+        return false;
+    }
+
+    bool ok = true;
+
+    for (i=0 ; i<blob->aspect_count ; i++)
+    {
+        const CamresBlobAspect *aspect = camres_blob_aspect(blob, i);
+
+        if (aspect->den == 0 || !camres_blob_string(blob, aspect->name))
+        {
+            qCritical("Camres error: Aspect ratio %u is invalid.", i);
+            ok = false;
+        }
+    }
+
+    for (m=0 ; m<blob->mode_count ; m++)
+    {
+        const CamresBlobMode *mode = camres_blob_mode(blob, m);
+        const CamresBlobMode *viewfinder = mode->viewfinder == CAMRES_BLOB_NONE ? NULL : camres_blob_mode(blob, mode->viewfinder);
+
+        if (mode->width == 0 || mode->height == 0 ||
+            mode->kind < CAMRES_BLOB_IMAGE || mode->kind > CAMRES_BLOB_VIEWFINDER ||
+            (mode->aspect != CAMRES_BLOB_NONE && mode->aspect >= blob->aspect_count) ||
+            (mode->viewfinder != CAMRES_BLOB_NONE && (!viewfinder || viewfinder->kind != CAMRES_BLOB_VIEWFINDER)))
+        {
+            qCritical("Camres error: Mode %u is invalid.", m);
+            ok = false;
+        }
+    }
+
+    qInfo("Camres: %s: version %u, %u bytes, %u cameras, %u modes, %u aspect ratios",
+          qPrintable(filename), blob->version, blob->size, blob->camera_count, blob->mode_count, blob->aspect_count);
+
+    for (i=0 ; i<blob->camera_count ; i++)
+    {
+        const CamresBlobCamera *camera = camres_blob_camera(blob, i);
+        const char *name = camres_blob_string(blob, camera->name);
+
+        if (!name || (quint64)camera->first_mode + camera->mode_count > blob->mode_count)
+        {
+            qCritical("Camres error: Camera %u is invalid.", i);
+            ok = false;
+            continue;
+        }
+
+        qInfo("\n%s (%d):", name, camera->device);
+
+        for (m=camera->first_mode ; m<camera->first_mode + camera->mode_count ; m++)
+        {
+            const CamresBlobMode *mode = camres_blob_mode(blob, m);
+            const CamresBlobAspect *aspect = camres_blob_aspect(blob, mode->aspect);
+            const CamresBlobMode *viewfinder = camres_blob_mode(blob, mode->viewfinder);
+            const char *aspectName = aspect ? camres_blob_string(blob, aspect->name) : NULL;
+
+            // Viewfinders are paired within their own camera
+            if (viewfinder && (mode->viewfinder < camera->first_mode ||
+                               mode->viewfinder >= camera->first_mode + camera->mode_count))
+            {
+                qCritical("Camres error: Mode %u is paired with a viewfinder of another camera.", m);
+                ok = false;
+            }
+
+            qInfo("%s %s (%s)%s%s",
+                  mode->kind == CAMRES_BLOB_IMAGE ? "image" : mode->kind == CAMRES_BLOB_VIDEO ? "video" : "viewfinder",
+                  qPrintable(modeString(mode)),
+                  aspectName ? aspectName : "?:?",
+                  viewfinder ? ", viewfinder " : "",
+                  viewfinder ? qPrintable(modeString(viewfinder)) : "");
+        }
+    }
+
+    if (ok)
+        qInfo("Camres: %s is valid", qPrintable(filename));
+
+    return ok;
+}
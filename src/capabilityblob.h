@@ -0,0 +1,25 @@
+#ifndef CAPABILITYBLOB_H
+#define CAPABILITYBLOB_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include "cameraplan.h"
+
+/*
+ * Writes and checks the binary capability blob, see camresblob.h for
+ * the layout. It carries the same cameras and modes as the JSON, so a
+ * camera app can map it instead of parsing the JSON at every start.
+ */
+class CapabilityBlob
+{
+public:
+    static QByteArray build(const QList<CameraPlan> &plans);
+
+    // Checks every offset and index of the blob in filename and prints
+    // its contents
+    static bool verify(const QString &filename);
+};
+
+#endif // CAPABILITYBLOB_H
@@ -0,0 +1,273 @@
+#include "capswalker.h"
+
+#include <QSet>
+#include <QVarLengthArray>
+
+class IntSequence
+{
+public:
+    explicit IntSequence(const GValue *value) :
+        m_count(0),
+        m_rangeOnly(true)
+    {
+        if (value)
+            add(value);
+
+        if (m_segments.isEmpty())
+            m_rangeOnly = false;
+    }
+
+    int count() const { return m_count; }
+    bool isRange() const { return m_rangeOnly; }
+
+    int at(int index) const
+    {
+        int i;
+
+        for (i=0 ; i<m_segments.size() ; i++)
+        {
+            const Segment &s = m_segments.at(i);
+
+            if (index < s.count)
+                return s.step ? s.min + index * s.step : (index ? s.max : s.min);
+
+            index -= s.count;
+        }
+
+        return 0;
+    }
+
+private:
+    struct Segment
+    {
+        int min;
+        int max;
+        int step; // 0 when only the bounds are walked
+        int count;
+    };
+
+    void add(const GValue *value)
+    {
+        Segment s;
+
+        if (G_VALUE_HOLDS_INT(value))
+        {
+            s.min = s.max = g_value_get_int(value);
+            s.step = 1;
+            s.count = 1;
+            m_rangeOnly = false;
+        }
+        else if (GST_VALUE_HOLDS_INT_RANGE(value))
+        {
+            s.min = gst_value_get_int_range_min(value);
+            s.max = gst_value_get_int_range_max(value);
+            s.step = gst_value_get_int_range_step(value);
+
+            if (s.step <= 1)
+            {
+                s.step = 0;
+                s.count = (s.min == s.max) ? 1 : 2;
+            }
+            else
+            {
+                s.count = (s.max - s.min) / s.step + 1;
+            }
+        }
+        else if (GST_VALUE_HOLDS_LIST(value))
+        {
+            guint i;
+
+            for (i=0 ; i<gst_value_list_get_size(value) ; i++)
+                add(gst_value_list_get_value(value, i));
+
+            return;
+        }
+        else
+        {
+            qWarning("Camres error: Unknown size type %s", G_VALUE_TYPE_NAME(value));
+            return;
+        }
+
+        m_segments.append(s);
+        m_count += s.count;
+    }
+
+    QVarLengthArray<Segment, 4> m_segments;
+    int m_count;
+    bool m_rangeOnly;
+};
+
+static void addFramerates(const GValue *value, QVarLengthArray<const GValue *, 8> &res)
+{
+    if (value && GST_VALUE_HOLDS_LIST(value))
+    {
+        guint i;
+
+        for (i=0 ; i<gst_value_list_get_size(value) ; i++)
+            addFramerates(gst_value_list_get_value(value, i), res);
+    }
+    else
+    {
+        res.append(value);
+    }
+}
+
+static void setFramerate(CamMode &mode, const GValue *fps)
+{
+    mode.fpsNum = mode.fpsDen = mode.fpsMaxNum = mode.fpsMaxDen = 0;
+
+    if (fps && GST_VALUE_HOLDS_FRACTION(fps))
+    {
+        mode.fpsNum = mode.fpsMaxNum = gst_value_get_fraction_numerator(fps);
+        mode.fpsDen = mode.fpsMaxDen = gst_value_get_fraction_denominator(fps);
+    }
+    else if (fps && GST_VALUE_HOLDS_FRACTION_RANGE(fps))
+    {
+        const GValue *fps_min = gst_value_get_fraction_range_min(fps);
+        const GValue *fps_max = gst_value_get_fraction_range_max(fps);
+        mode.fpsNum = gst_value_get_fraction_numerator(fps_min);
+        mode.fpsDen = gst_value_get_fraction_denominator(fps_min);
+        mode.fpsMaxNum = gst_value_get_fraction_numerator(fps_max);
+        mode.fpsMaxDen = gst_value_get_fraction_denominator(fps_max);
+    }
+    else if (fps)
+    {
+        qWarning("Camres error: Unknown framerate type");
+    }
+}
+
+// Of a list of formats the one with the largest frames, so that the
+// memory estimate holds whichever of them is negotiated
+static QByteArray formatName(const GstStructure *s)
+{
+    const GValue *format = gst_structure_get_value(s, "format");
+
+    if (format && GST_VALUE_HOLDS_LIST(format))
+    {
+        QByteArray res;
+        guint i;
+
+        for (i=0 ; i<gst_value_list_get_size(format) ; i++)
+        {
+            const GValue *item = gst_value_list_get_value(format, i);
+
+            if (!G_VALUE_HOLDS_STRING(item))
+                continue;
+
+            QByteArray name = g_value_get_string(item);
+
+            if (res.isEmpty() || CamMode::bitsPerPixel(name) > CamMode::bitsPerPixel(res))
+                res = name;
+        }
+
+        if (!res.isEmpty())
+            return res;
+    }
+
+    if (format && G_VALUE_HOLDS_STRING(format))
+        return g_value_get_string(format);
+
+    return gst_structure_get_name(s);
+}
+
+int CapsWalker::walk(GstCaps *caps, CamMode::Kind kind, const Visitor &visitor)
+{
+    int visited = 0;
+
+    if (!caps)
+    {
+        return visited;
+    }
+
+    for (guint x = 0; x < gst_caps_get_size(caps); x++)
+    {
+        const GstStructure *s = gst_caps_get_structure(caps, x);
+        IntSequence widths(gst_structure_get_value(s, "width"));
+        IntSequence heights(gst_structure_get_value(s, "height"));
+        QVarLengthArray<const GValue *, 8> framerates;
+
+        if (!widths.count() || !heights.count())
+        {
+            continue;
+        }
+
+        addFramerates(gst_structure_get_value(s, "framerate"), framerates);
+
+        QByteArray format = formatName(s);
+        bool lockstep = widths.isRange() && heights.isRange();
+        bool endpoints = lockstep && widths.count() != heights.count();
+        qint64 sizes;
+
+        // Ranges with different steps cannot be paired step by step
+        // without inventing sizes, keep only the smallest and largest
+        if (endpoints)
+        {
+            gchar *desc = gst_structure_to_string(s);
+            qWarning("Camres warning: Width and height ranges differ in steps, using their endpoints: %s", desc);
+            g_free(desc);
+            sizes = 2;
+        }
+        else
+        {
+            sizes = lockstep ? widths.count() : (qint64)widths.count() * heights.count();
+        }
+
+        for (qint64 n = 0; n < sizes; n++)
+        {
+            int w, h;
+
+            if (endpoints)
+            {
+                w = n ? widths.count() - 1 : 0;
+                h = n ? heights.count() - 1 : 0;
+            }
+            else if (lockstep)
+            {
+                w = h = (int)n;
+            }
+            else
+            {
+                w = (int)(n / heights.count());
+                h = (int)(n % heights.count());
+            }
+
+            CamMode mode(widths.at(w), heights.at(h), kind);
+
+            mode.format = format;
+
+            for (int f = 0; f < framerates.size(); f++)
+            {
+                if (visited == MaxModes)
+                {
+                    qWarning("Camres warning: Caps describe more than %d modes, ignoring the rest", MaxModes);
+                    return visited;
+                }
+
+                setFramerate(mode, framerates.at(f));
+                visited++;
+
+                if (!visitor(mode))
+                    return visited;
+            }
+        }
+    }
+
+    return visited;
+}
+
+CamModeList CapsWalker::modes(GstCaps *caps, CamMode::Kind kind)
+{
+    CamModeList res;
+    QSet<CamMode> seen;
+
+    walk(caps, kind, [&res, &seen](const CamMode &mode) {
+        if (!seen.contains(mode))
+        {
+            seen.insert(mode);
+            res.append(mode);
+        }
+        return true;
+    });
+
+    return res;
+}
@@ -0,0 +1,38 @@
+#ifndef CAPSWALKER_H
+#define CAPSWALKER_H
+
+#include <functional>
+
+#include <gst/gst.h>
+
+#include "cammode.h"
+
+/*
+ * Walks the modes described by caps without expanding them up front.
+ *
+ * Width and height may be ints, int ranges (optionally stepped) or lists
+ * of those. Framerates may be fractions, fraction ranges or lists of
+ * those; fraction ranges are kept as ranges in the mode. Continuous int
+ * ranges yield only their bounds, stepped ranges yield every step. When
+ * both width and height are ranges they describe one scalable size and
+ * are walked in lockstep instead of as a cartesian product, provided
+ * both have the same number of steps. Otherwise only the smallest and
+ * the largest size are visited.
+ */
+class CapsWalker
+{
+public:
+    typedef std::function<bool (const CamMode &)> Visitor;
+
+    // Upper bound on the modes visited in one walk
+    static const int MaxModes = 4096;
+
+    // Calls visitor for each mode until it returns false. Returns the
+    // number of modes visited.
+    static int walk(GstCaps *caps, CamMode::Kind kind, const Visitor &visitor);
+
+    // All distinct modes in caps, in the order they are advertised
+    static CamModeList modes(GstCaps *caps, CamMode::Kind kind);
+};
+
+#endif // CAPSWALKER_H
@@ -0,0 +1,416 @@
+#include "encodebench.h"
+#include "camres.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QVector>
+
+#include <gst/pbutils/encoding-profile.h>
+
+// A mode is sustained when the encoder keeps up with 95% of its framerate
+#define SUSTAINED_RATIO 0.95
+
+struct BurstState
+{
+    QMutex lock;
+    QElapsedTimer clock;
+    QHash<GstClockTime, qint64> entered;
+    int target;
+    int frames;
+    qint64 first;
+    qint64 last;
+    qint64 latencyTotal;
+    int latencyCount;
+};
+
+static GstPadProbeReturn enterProbe(GstPad *, GstPadProbeInfo *info, gpointer userData)
+{
+    BurstState *state = static_cast<BurstState *>(userData);
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    if (GST_BUFFER_PTS_IS_VALID(buffer))
+    {
+        QMutexLocker locker(&state->lock);
+        state->entered.insert(GST_BUFFER_PTS(buffer), state->clock.nsecsElapsed());
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn exitProbe(GstPad *, GstPadProbeInfo *info, gpointer userData)
+{
+    BurstState *state = static_cast<BurstState *>(userData);
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    // Codec headers are not frames
+    if (!GST_BUFFER_PTS_IS_VALID(buffer) || GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_HEADER))
+    {
+        return GST_PAD_PROBE_OK;
+    }
+
+    qint64 now = state->clock.nsecsElapsed();
+    QMutexLocker locker(&state->lock);
+
+    if (state->frames == 0)
+        state->first = now;
+    state->last = now;
+    state->frames++;
+
+    QHash<GstClockTime, qint64>::iterator it = state->entered.find(GST_BUFFER_PTS(buffer));
+    if (it != state->entered.end())
+    {
+        state->latencyTotal += now - it.value();
+        state->latencyCount++;
+        state->entered.erase(it);
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+class EncodeTask : public QRunnable
+{
+public:
+    EncodeTask(EncodeBench *bench, const CamModeList &modes, QAtomicInt *next,
+               QVector<EncodeBench::Result> *results) :
+        m_bench(bench), m_modes(modes), m_next(next), m_results(results)
+    {
+    }
+
+    void run()
+    {
+        // Same as ProbeTask, keep the sources of the elements off the
+        // default main context
+        GMainContext *context = g_main_context_new();
+        g_main_context_push_thread_default(context);
+
+        int n;
+        while ((n = m_next->fetchAndAddOrdered(1)) < m_modes.size())
+            (*m_results)[n] = m_bench->run(m_modes.at(n));
+
+        g_main_context_pop_thread_default(context);
+        g_main_context_unref(context);
+    }
+
+private:
+    EncodeBench *m_bench;
+    CamModeList m_modes;
+    QAtomicInt *m_next;
+    QVector<EncodeBench::Result> *m_results;
+};
+
+EncodeBench::EncodeBench(Camres *camres, QObject *parent) :
+    QObject(parent),
+    m_camres(camres),
+    m_source("videotestsrc")
+{
+}
+
+void EncodeBench::setSource(const QString &description)
+{
+    m_source = description;
+}
+
+void EncodeBench::setEncoder(const QByteArray &factoryName)
+{
+    m_encoder = factoryName;
+}
+
+QString EncodeBench::key(const CamMode &mode)
+{
+    return QString("%1@%2/%3").arg(mode.resolution()).arg(mode.fpsMaxNum).arg(mode.fpsMaxDen);
+}
+
+GstElement *EncodeBench::createEncoder()
+{
+    if (!m_encoder.isEmpty())
+    {
+        GstElement *encoder = gst_element_factory_make(m_encoder.constData(), NULL);
+
+        if (!encoder)
+            qCritical("Camres error: Failed to create encoder %s.", m_encoder.constData());
+
+        return encoder;
+    }
+
+    GstEncodingProfile *profile = m_camres->profile();
+    GstEncodingProfile *videoProfile = NULL;
+
+    if (!profile)
+    {
+        return NULL;
+    }
+
+    // Only the video stream is encoded. A muxer would merge the frames
+    // and hide the per frame latency.
+    const GList *l;
+    for (l = gst_encoding_container_profile_get_profiles(GST_ENCODING_CONTAINER_PROFILE(profile)) ; l ; l = l->next)
+    {
+        if (GST_IS_ENCODING_VIDEO_PROFILE(l->data))
+        {
+            videoProfile = GST_ENCODING_PROFILE(l->data);
+            break;
+        }
+    }
+
+    if (!videoProfile)
+    {
+        qCritical("Camres error: No video stream in the encoding profile.");
+        return NULL;
+    }
+
+    GstElement *encoder = gst_element_factory_make("encodebin", NULL);
+    if (!encoder)
+    {
+        qCritical("Camres error: Failed to create encodebin.");
+        return NULL;
+    }
+
+    g_object_set(encoder, "profile", videoProfile, NULL);
+
+    return encoder;
+}
+
+EncodeBench::Result EncodeBench::run(const CamMode &mode)
+{
+    Result res;
+    GError *error = NULL;
+
+    GstElement *source = gst_parse_bin_from_description(m_source.toLatin1().constData(), TRUE, &error);
+    if (!source)
+    {
+        qCritical("Camres error: Failed to create source %s: %s", qPrintable(m_source), error->message);
+        g_error_free(error);
+        return res;
+    }
+
+    GstElement *filter = gst_element_factory_make("capsfilter", NULL);
+    GstElement *encoder = createEncoder();
+    GstElement *sink = gst_element_factory_make("fakesink", NULL);
+    GstElement *pipeline = gst_pipeline_new(NULL);
+
+    if (!filter || !encoder || !sink || !pipeline)
+    {
+        qCritical("Camres error: Failed to create the encoder pipeline.");
+        gst_object_unref(gst_object_ref_sink(source));
+        if (filter)
+            gst_object_unref(gst_object_ref_sink(filter));
+        if (encoder)
+            gst_object_unref(gst_object_ref_sink(encoder));
+        if (sink)
+            gst_object_unref(gst_object_ref_sink(sink));
+        if (pipeline)
+            gst_object_unref(pipeline);
+        return res;
+    }
+
+    GstCaps *caps = gst_caps_new_simple("video/x-raw",
+                                        "width", G_TYPE_INT, mode.width,
+                                        "height", G_TYPE_INT, mode.height,
+                                        "framerate", GST_TYPE_FRACTION, mode.fpsMaxNum, mode.fpsMaxDen,
+                                        NULL);
+    g_object_set(filter, "caps", caps, NULL);
+    gst_caps_unref(caps);
+
+    g_object_set(sink, "sync", FALSE, NULL);
+
+    gst_bin_add_many(GST_BIN(pipeline), source, filter, encoder, sink, NULL);
+
+    if (!gst_element_link_many(source, filter, encoder, sink, NULL))
+    {
+        qCritical("Camres error: Failed to link the encoder pipeline for %s.", qPrintable(key(mode)));
+        gst_object_unref(pipeline);
+        return res;
+    }
+
+    BurstState state;
+    state.target = qMax(10, (int)((qint64)mode.fpsMaxNum * BurstMs / (1000 * (qint64)mode.fpsMaxDen)));
+    state.frames = 0;
+    state.first = 0;
+    state.last = 0;
+    state.latencyTotal = 0;
+    state.latencyCount = 0;
+    state.clock.start();
+
+    GstPad *enterPad = gst_element_get_static_pad(filter, "src");
+    GstPad *exitPad = gst_element_get_static_pad(sink, "sink");
+    gst_pad_add_probe(enterPad, GST_PAD_PROBE_TYPE_BUFFER, enterProbe, &state, NULL);
+    gst_pad_add_probe(exitPad, GST_PAD_PROBE_TYPE_BUFFER, exitProbe, &state, NULL);
+    gst_object_unref(enterPad);
+    gst_object_unref(exitPad);
+
+    GstBus *bus = gst_element_get_bus(pipeline);
+    QElapsedTimer timer;
+    bool done = false;
+
+    timer.start();
+
+    if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+    {
+        qCritical("Camres error: Failed to start the encoder pipeline for %s.", qPrintable(key(mode)));
+        done = true;
+    }
+
+    // Give up on an encoder running at a fraction of the rate, what was
+    // encoded until then is enough to tell it is not sustained
+    while (!done && timer.elapsed() < BurstMs * 4 + 2000)
+    {
+        GstMessage *msg = gst_bus_timed_pop_filtered(bus, 20 * GST_MSECOND,
+                                                     (GstMessageType)(GST_MESSAGE_ERROR | GST_MESSAGE_EOS));
+
+        if (msg)
+        {
+            if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR)
+            {
+                GError *err = NULL;
+                gst_message_parse_error(msg, &err, NULL);
+                qWarning("Camres warning: Encoding %s failed: %s", qPrintable(key(mode)), err->message);
+                g_error_free(err);
+            }
+            gst_message_unref(msg);
+            done = true;
+        }
+
+        QMutexLocker locker(&state.lock);
+        if (state.frames >= state.target)
+            done = true;
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(bus);
+    gst_object_unref(pipeline);
+
+    res.frames = state.frames;
+    if (state.frames > 1 && state.last > state.first)
+        res.fps = (state.frames - 1) * 1000000000.0 / (state.last - state.first);
+    if (state.latencyCount > 0)
+        res.latencyMs = state.latencyTotal / (state.latencyCount * 1000000.0);
+    res.sustained = res.fps >= SUSTAINED_RATIO * mode.fpsMaxNum / mode.fpsMaxDen;
+
+    return res;
+}
+
+bool EncodeBench::filter(QList<QList<QPair<QString, CamModeList> > > &resolutions, int jobs)
+{
+    QHash<QString, Result> results;
+    CamModeList modes;
+    int i, j, m;
+
+    for (i=0 ; i<resolutions.size() ; i++)
+    {
+        for (j=0 ; j<resolutions.at(i).size() ; j++)
+        {
+            const CamModeList &res = resolutions.at(i).at(j).second;
+
+            for (m=0 ; m<res.size() ; m++)
+            {
+                if (res.at(m).kind != CamMode::Video || !res.at(m).hasFramerate() || results.contains(key(res.at(m))))
+                    continue;
+
+                results.insert(key(res.at(m)), Result());
+                modes.append(res.at(m));
+            }
+        }
+    }
+
+    if (modes.isEmpty())
+    {
+        return true;
+    }
+
+    QVector<Result> measured(modes.size());
+    QAtomicInt next(0);
+
+    qInfo("Camres: Measuring encoder throughput for %d video modes...", modes.size());
+
+    if (jobs > 1)
+    {
+        QThreadPool pool;
+        pool.setMaxThreadCount(qMin(jobs, modes.size()));
+
+        for (i=0 ; i<pool.maxThreadCount() ; i++)
+            pool.start(new EncodeTask(this, modes, &next, &measured));
+
+        pool.waitForDone();
+    }
+
+    // Encoders share the hardware, a mode that fell short next to other
+    // bursts gets a second chance on its own
+    CamModeList retry;
+    QVector<int> retryIndex;
+
+    for (i=0 ; i<modes.size() ; i++)
+    {
+        if (jobs <= 1 || !measured.at(i).sustained)
+        {
+            retry.append(modes.at(i));
+            retryIndex.append(i);
+        }
+    }
+
+    if (!retry.isEmpty())
+    {
+        QVector<Result> serial(retry.size());
+        next.store(0);
+        EncodeTask task(this, retry, &next, &serial);
+        task.run();
+
+        for (i=0 ; i<retry.size() ; i++)
+            measured[retryIndex.at(i)] = serial.at(i);
+    }
+
+    bool any = false;
+
+    for (i=0 ; i<modes.size() ; i++)
+    {
+        const Result &r = measured.at(i);
+
+        results.insert(key(modes.at(i)), r);
+        any = any || r.frames > 0;
+
+        qInfo("Camres: Encoded %s at %.1f fps, %.1f ms latency%s", qPrintable(key(modes.at(i))),
+              r.fps, r.latencyMs, r.sustained ? "" : " (not sustained)");
+    }
+
+    if (!any)
+    {
+        qCritical("Camres error: No video mode could be encoded, keeping all video modes.");
+        return false;
+    }
+
+    for (i=0 ; i<resolutions.size() ; i++)
+    {
+        for (j=0 ; j<resolutions.at(i).size() ; j++)
+        {
+            CamModeList &res = resolutions[i][j].second;
+            CamModeList kept;
+
+            for (m=0 ; m<res.size() ; m++)
+            {
+                if (res.at(m).kind != CamMode::Video || !res.at(m).hasFramerate() || results.value(key(res.at(m))).sustained)
+                    kept.append(res.at(m));
+            }
+
+            if (kept.size() == res.size())
+                continue;
+
+            bool hasVideo = false;
+            for (m=0 ; m<kept.size() && !hasVideo ; m++)
+                hasVideo = kept.at(m).kind == CamMode::Video;
+
+            if (!hasVideo)
+            {
+                qWarning("Camres warning: No sustained video mode in %s, keeping all of them.",
+                         qPrintable(resolutions.at(i).at(j).first));
+                continue;
+            }
+
+            res = kept;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef ENCODEBENCH_H
+#define ENCODEBENCH_H
+
+#include <QObject>
+#include <QHash>
+#include <QStringList>
+
+#include <gst/gst.h>
+
+#include "cammode.h"
+
+class Camres;
+
+/*
+ * Measures whether the video encoder sustains each advertised video mode.
+ *
+ * For every distinct resolution and top framerate a short burst is
+ * pushed from the source through the encoder as fast as the encoder
+ * accepts it:
+ *
+ *   source ! capsfilter ! encoder ! fakesink sync=false
+ *
+ * The source is any bin description producing raw video, videotestsrc
+ * by default. The encoder is encodebin with the video stream of
+ * video.gep, or any encoder element given with setEncoder(). The achieved
+ * framerate and the mean latency through the encoder are measured on the
+ * pads around the encoder.
+ */
+class EncodeBench : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Result
+    {
+        Result() : frames(0), fps(0), latencyMs(0), sustained(false) {}
+
+        int frames;
+        double fps;
+        double latencyMs;
+        bool sustained;
+    };
+
+    // Length of the encoded burst
+    static const int BurstMs = 1000;
+
+    explicit EncodeBench(Camres *camres, QObject *parent = 0);
+
+    void setSource(const QString &description);
+    void setEncoder(const QByteArray &factoryName);
+
+    Result run(const CamMode &mode);
+
+    // Measures the video modes of all cameras, up to jobs at a time, and
+    // drops the ones that are not sustained. A camera keeps its modes when
+    // none of them is sustained. Returns false if nothing could be measured.
+    bool filter(QList<QList<QPair<QString, CamModeList> > > &resolutions, int jobs);
+
+    // "WxH@n/d" of the top framerate, the key results are stored under
+    static QString key(const CamMode &mode);
+
+private:
+    GstElement *createEncoder();
+
+    Camres *m_camres;
+    QString m_source;
+    QByteArray m_encoder;
+};
+
+#endif // ENCODEBENCH_H
@@ -1,19 +1,86 @@
 #include <stdio.h>
+#include <unistd.h>
+#include <QCoreApplication>
 #include <QtGui/QGuiApplication>
 #include <QtGlobal>
-#include <QScreen>
+#include <QScopedPointer>
+#include <QThread>
+#include <QFile>
+#include <QFileInfo>
 
 #include "camres.h"
 #include "outputgen.h"
+#include "probecache.h"
+#include "timings.h"
+#include "screengeometry.h"
+#include "minimalregistry.h"
+#include "encodebench.h"
+#include "viewfinderbench.h"
+#include "recording.h"
+#include "batch.h"
+#include "photography.h"
+#include "capabilityblob.h"
 
 int main(int argc, char *argv[])
 {
-    QGuiApplication app(argc, argv);
+    if (argc > 2 && QString(argv[1]).compare("--verify-blob") == 0)
+    {
+        qInfo("Camres version %s", APP_VERSION);
+
+        return CapabilityBlob::verify(QString(argv[2])) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (argc > 2 && QString(argv[1]).compare("--batch") == 0)
+    {
+        QCoreApplication app(argc, argv);
+        Batch batch;
+        int jobs = QThread::idealThreadCount();
+
+        qInfo("Camres version %s", APP_VERSION);
+
+        if (argc > 3)
+        {
+            bool ok;
+            int n = QString(argv[3]).toInt(&ok);
+            if (ok && n > 0)
+                jobs = n;
+        }
+
+        // Parsing recordings needs no plugins
+        MinimalRegistry::prepare();
+
+        return batch.run(QString(argv[2]), jobs) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    QScopedPointer<QCoreApplication> app;
     QString jsonFilename = QString();
     QString camhwFilename = QString();
+    QString blobFilename = QString();
+    QString screenSize = QString();
+    QString encodeSource = QString();
+    QByteArray encoder = QByteArray();
+    QList<QPair<QString, QString> > camhwTemplates;
     int genJson = 0;
     int genCamhw = 0;
+    int genBlob = 0;
+    int parallel = 0;
+    int useFixture = 0;
+    int timings = 0;
+    int viewfinderBench = 0;
+    int record = 0;
+    int replay = 0;
+    int jobs = 1;
+    qint64 memoryBudget = -1;
+    int cameraTimeout = Camres::DefaultCameraTimeoutMs;
+    int probeTimeout = Camres::DefaultProbeTimeoutMs;
+    bool fullProbe = false;
+    bool gstTracers = false;
+    bool minimalRegistry = false;
+    bool encodeBench = false;
+    bool readCache = true;
+    bool writeCache = true;
     bool printUsage = true;
+    bool badArgs = false;
 
     qInfo("Camres version %s", APP_VERSION);
 
@@ -29,9 +96,132 @@ int main(int argc, char *argv[])
                 genJson = i;
             if (QString(argv[i]).compare("-w") == 0)
                 genCamhw = i;
+            if (QString(argv[i]).compare("-b") == 0)
+                genBlob = i;
+            if (QString(argv[i]).compare("-j") == 0)
+                parallel = i;
+            if (QString(argv[i]).compare("--fixture") == 0 && i+1 < argc)
+            {
+                useFixture = i;
+                readCache = false;
+                writeCache = false;
+                printUsage = false;
+            }
+            if (QString(argv[i]).compare("-t") == 0 && i+1 < argc)
+            {
+                QString arg(argv[i+1]);
+                int sep = arg.lastIndexOf('=');
+                if (sep <= 0 || sep == arg.size()-1)
+                {
+                    badArgs = true;
+                    continue;
+                }
+                camhwTemplates << qMakePair(arg.left(sep), arg.mid(sep+1));
+                printUsage = false;
+            }
+            if (QString(argv[i]).compare("--full-probe") == 0)
+            {
+                fullProbe = true;
+                printUsage = false;
+            }
+            if (QString(argv[i]).compare("--no-cache") == 0)
+            {
+                readCache = false;
+                writeCache = false;
+                printUsage = false;
+            }
+            if (QString(argv[i]).compare("--refresh") == 0)
+            {
+                readCache = false;
+                printUsage = false;
+            }
+            if (QString(argv[i]).compare("--screen") == 0 && i+1 < argc)
+            {
+                screenSize = QString(argv[i+1]);
+                if (!ScreenGeometry::fromString(screenSize).isValid())
+                    badArgs = true;
+                printUsage = false;
+            }
+            if (QString(argv[i]).compare("--minimal-registry") == 0)
+            {
+                minimalRegistry = true;
+                printUsage = false;
+            }
+            if (QString(argv[i]).compare("--encode-bench") == 0)
+            {
+                encodeBench = true;
+                printUsage = false;
+            }
+            if (QString(argv[i]).compare("--encode-source") == 0 && i+1 < argc)
+                encodeSource = QString(argv[i+1]);
+            if (QString(argv[i]).compare("--encoder") == 0 && i+1 < argc)
+                encoder = QByteArray(argv[i+1]);
+            if (QString(argv[i]).compare("--vf-bench") == 0)
+            {
+                viewfinderBench = i;
+                printUsage = false;
+            }
+            if (QString(argv[i]).compare("--memory-budget") == 0 && i+1 < argc)
+            {
+                bool ok;
+                int mb = QString(argv[i+1]).toInt(&ok);
+                if (!ok || mb <= 0)
+                    badArgs = true;
+                else
+                    memoryBudget = (qint64)mb * 1024 * 1024;
+            }
+            if (QString(argv[i]).compare("--camera-timeout") == 0 && i+1 < argc)
+            {
+                bool ok;
+                cameraTimeout = QString(argv[i+1]).toInt(&ok);
+                if (!ok || cameraTimeout < 0)
+                    badArgs = true;
+            }
+            if (QString(argv[i]).compare("--probe-timeout") == 0 && i+1 < argc)
+            {
+                bool ok;
+                probeTimeout = QString(argv[i+1]).toInt(&ok);
+                if (!ok || probeTimeout < 0)
+                    badArgs = true;
+            }
+            if (QString(argv[i]).compare("--record") == 0 && i+1 < argc)
+            {
+                record = i;
+                printUsage = false;
+            }
+            if (QString(argv[i]).compare("--replay") == 0 && i+1 < argc)
+            {
+                replay = i;
+                readCache = false;
+                writeCache = false;
+                printUsage = false;
+            }
+            if (QString(argv[i]).compare("--timings") == 0)
+            {
+                timings = i;
+                printUsage = false;
+            }
+            if (QString(argv[i]).compare("--gst-tracers") == 0)
+            {
+                gstTracers = true;
+                printUsage = false;
+            }
         }
     }
 
+    if (parallel)
+    {
+        jobs = QThread::idealThreadCount();
+        if (argc-1 > parallel)
+        {
+            bool ok;
+            int n = QString(argv[parallel+1]).toInt(&ok);
+            if (ok && n > 0)
+                jobs = n;
+        }
+        printUsage = false;
+    }
+
     if (genJson)
     {
         jsonFilename = "camera-resolutions.json";
@@ -54,56 +244,310 @@ int main(int argc, char *argv[])
             if (!QString(argv[genCamhw+1]).startsWith("-"))
                 camhwFilename = QString(argv[genCamhw+1]);
         }
+        camhwTemplates.prepend(qMakePair(QString(CAMHW_TEMPLATE), camhwFilename));
+        printUsage = false;
+    }
+
+    if (genBlob)
+    {
+        blobFilename = "camera-resolutions.bin";
+        if (argc-1 > genBlob)
+        {
+            if (!QString(argv[genBlob+1]).startsWith("-"))
+                blobFilename = QString(argv[genBlob+1]);
+        }
         printUsage = false;
     }
 
-    if (printUsage)
+    int viewfinderDuration = ViewfinderBench::DefaultDurationMs;
+
+    if (viewfinderBench && argc-1 > viewfinderBench)
+    {
+        bool ok;
+        int n = QString(argv[viewfinderBench+1]).toInt(&ok);
+        if (ok && n > 0)
+            viewfinderDuration = n;
+    }
+
+    QString timingsFilename = QString();
+
+    if (timings)
+    {
+        // Keep the timings next to the generated files
+        QString dir = ".";
+        if (!jsonFilename.isEmpty())
+            dir = QFileInfo(jsonFilename).path();
+        else if (!blobFilename.isEmpty())
+            dir = QFileInfo(blobFilename).path();
+        else if (!camhwTemplates.isEmpty())
+            dir = QFileInfo(camhwTemplates.first().second).path();
+
+        timingsFilename = dir + "/camres-timings.json";
+        if (argc-1 > timings)
+        {
+            if (!QString(argv[timings+1]).startsWith("-"))
+                timingsFilename = QString(argv[timings+1]);
+        }
+        Timings::instance()->setEnabled(true);
+    }
+
+    if (gstTracers)
+    {
+        // Must be set before gst_init(), an explicit GST_TRACERS wins
+        if (!qEnvironmentVariableIsSet("GST_TRACERS"))
+            qputenv("GST_TRACERS", "latency;stats;rusage");
+        if (!qEnvironmentVariableIsSet("GST_DEBUG"))
+            qputenv("GST_DEBUG", "GST_TRACER:7");
+    }
+
+    if (printUsage || badArgs)
     {
         qInfo("Usage: camres [OPTION]\n");
         qInfo("  -o [filename]       Generate json for camera-settings-plugin");
         qInfo("  -w [filename]       Generate dconf for jolla-camera-hw.txt");
+        qInfo("  -t template=output  Generate dconf from another template, can be repeated");
+        qInfo("  -b [filename]       Generate a binary capability blob, see camresblob.h");
+        qInfo("  -j [jobs]           Probe cameras in parallel (default: number of CPUs)");
+        qInfo("  --full-probe        Always start camerabin to read the supported caps");
+        qInfo("  --no-cache          Do not use the probe cache");
+        qInfo("  --refresh           Ignore the probe cache and probe the cameras again");
+        qInfo("  --verify-blob file  Check a capability blob and print its contents");
+        qInfo("  --batch file [jobs] Generate the outputs of the devices in a manifest from recordings");
+        qInfo("  --fixture file      Probe a simulated camera described by file instead of droidcamsrc");
+        qInfo("  --screen WxH        Screen size for viewfinder selection (default: from DRM, fbdev or Qt)");
+        qInfo("  --minimal-registry  Load only the needed GStreamer plugins instead of the system registry");
+        qInfo("  --encode-bench      Drop video modes the encoder cannot sustain");
+        qInfo("  --encode-source bin Raw video source for --encode-bench (default: videotestsrc)");
+        qInfo("  --encoder element   Encoder for --encode-bench (default: encodebin with video.gep)");
+        qInfo("  --vf-bench [ms]     Measure the delivered rate of the viewfinder candidates (default: 2000 ms each)");
+        qInfo("  --memory-budget MB  Only offer modes whose buffers fit in MB megabytes");
+        qInfo("  --camera-timeout ms Give up on a camera after ms milliseconds, 0 for never (default: 15000)");
+        qInfo("  --probe-timeout ms  Give up on probing after ms milliseconds, 0 for never (default: 60000)");
+        qInfo("  --record file       Save the probed cameras and caps to file");
+        qInfo("  --replay file       Generate the outputs from a recording instead of the cameras");
+        qInfo("  --timings [file]    Print per-phase timings and write them to file (default: camres-timings.json)");
+        qInfo("  --gst-tracers       Enable the GStreamer latency, stats and rusage tracers");
 
         return EXIT_FAILURE;
     }
 
-    int i;
+    QRect screen;
+    bool needScreen = !jsonFilename.isEmpty() || !blobFilename.isEmpty() || !camhwTemplates.isEmpty() || viewfinderBench;
+
+    if (needScreen)
+    {
+        PhaseTimer phase("screen-geometry");
+        screen = ScreenGeometry::detect(screenSize);
+    }
+
+    // Only bring up a Qt platform plugin when the kernel does not tell
+    // the screen size.
+    if (needScreen && !screen.isValid())
+    {
+        PhaseTimer phase("screen-geometry-qt");
+        app.reset(new QGuiApplication(argc, argv));
+        screen = ScreenGeometry::fromQt();
+        qInfo("Camres: Screen size %dx%d from Qt", screen.width(), screen.height());
+    }
+    else
+    {
+        app.reset(new QCoreApplication(argc, argv));
+    }
+
+    if (useFixture)
+    {
+        QFileInfo fixture(QString(argv[useFixture+1]));
+
+        if (!fixture.isReadable())
+        {
+            qCritical("Camres error: Cannot read fixture %s.", qPrintable(fixture.filePath()));
+            return EXIT_FAILURE;
+        }
+
+        qputenv("CAMRES_FIXTURE", QFile::encodeName(fixture.absoluteFilePath()));
+    }
+
+    // Replaying needs no plugins unless the recording is measured
+    if (minimalRegistry || (replay && !encodeBench && !viewfinderBench))
+        MinimalRegistry::prepare();
+
     Camres cr;
+    cr.setFastProbe(!fullProbe);
+    cr.setCameraTimeout(cameraTimeout);
+    cr.setProbeTimeout(probeTimeout);
 
-    qInfo("Searching cameras...");
+    // camresfixturesrc of tests/fixture reads the fixture when it is
+    // created, its plugin is found through GST_PLUGIN_PATH
+    if (useFixture)
+        cr.setSourceElement("camresfixturesrc");
+
+    if (minimalRegistry)
+    {
+        PhaseTimer phase("load-plugins");
+        if (!MinimalRegistry::load(cr.sourceElement(), cr.fastProbe(), encodeBench ? encoder : QByteArray()))
+            return EXIT_FAILURE;
+    }
 
-    QList<QPair<QString, int> > cameras = cr.getCameras();
+    QList<QPair<QString, int> > cameras;
+    QList<QList<QPair<QString, QString> > > cameraCaps;
+    QList<Photography> cameraPhotography;
 
-    if (cameras.isEmpty())
+    if (replay)
     {
-        qFatal("Camres error: No cameras found.");
-        return EXIT_FAILURE;
+        PhaseTimer phase("load-recording");
+        if (!Recording::load(QString(argv[replay+1]), cameras, cameraCaps, cameraPhotography))
+            return EXIT_FAILURE;
     }
+    else
+    {
+        qInfo("Searching cameras...");
+
+        cameras = cr.getCameras();
+
+        if (cameras.isEmpty())
+        {
+            qFatal("Camres error: No cameras found.");
+            return EXIT_FAILURE;
+        }
+
+        QStringList caps;
+        caps << "image-capture-supported-caps";
+        caps << "video-capture-supported-caps";
+        caps << "viewfinder-supported-caps";
+
+        ProbeCache cache;
 
-    QStringList caps;
-    caps << "image-capture-supported-caps";
-    caps << "video-capture-supported-caps";
-    caps << "viewfinder-supported-caps";
+        if (readCache || writeCache)
+            cache.setFingerprint(cameras);
 
-    QList<QList<QPair<QString, QStringList> > > resolutions;
+        bool cached = false;
+
+        if (readCache)
+        {
+            PhaseTimer phase("load-cache");
+            cached = cache.load(cameraCaps, cameraPhotography) && cameraCaps.size() == cameras.size();
+        }
+
+        if (cached)
+        {
+            qInfo("Camres: Using cached resolutions from %s", qPrintable(ProbeCache::defaultFilename()));
+        }
+        else
+        {
+            cameraCaps = cr.getAllCaps(cameras, caps, jobs, &cameraPhotography);
+
+            if (writeCache && !cameraCaps.contains(QList<QPair<QString, QString> >()))
+            {
+                PhaseTimer phase("save-cache");
+                cache.save(cameraCaps, cameraPhotography);
+            }
+
+            // Fall back to what an earlier run found for the cameras that
+            // failed or timed out, even if the camera list has changed
+            QList<QList<QPair<QString, QString> > > previous;
+            QList<Photography> previousPhotography;
+
+            if (readCache && cameraCaps.contains(QList<QPair<QString, QString> >()) &&
+                cache.load(previous, previousPhotography, true) && previous.size() == cameraCaps.size())
+            {
+                int c;
+                for (c=0 ; c<cameraCaps.size() ; c++)
+                {
+                    if (cameraCaps.at(c).isEmpty() && !previous.at(c).isEmpty())
+                    {
+                        qWarning("Camres warning: Using cached resolutions for %s, results are partial.",
+                                 qPrintable(cameras.at(c).first));
+                        cameraCaps[c] = previous.at(c);
+                        cameraPhotography[c] = previousPhotography.at(c);
+                    }
+                }
+            }
+        }
+    }
+
+    if (record && !Recording::save(QString(argv[record+1]), cameras, cameraCaps, cameraPhotography))
+        return EXIT_FAILURE;
+
+    QList<QList<QPair<QString, CamModeList> > > resolutions;
 
-    for (i=0 ; i<cameras.size() ; i++)
     {
-        qInfo("Searching resolutions for %s...", qPrintable(cameras.at(i).first));
-        QList<QPair<QString, QStringList> > res = cr.getResolutions(cameras.at(i).second, caps);
+        PhaseTimer phase("parse");
+        resolutions = Camres::parse(cameraCaps);
+    }
 
-        resolutions.append(res);
+    if (encodeBench)
+    {
+        PhaseTimer phase("encode-bench");
+        EncodeBench bench(&cr);
+
+        if (!encodeSource.isEmpty())
+            bench.setSource(encodeSource);
+        bench.setEncoder(encoder);
+        bench.filter(resolutions, jobs);
     }
 
     OutputGen og;
+    QList<ViewfinderIndex> viewfinders;
+    QList<CameraPlan> plans;
 
-    if (jsonFilename.isEmpty() && camhwFilename.isEmpty())
-        og.dump(cameras, resolutions);
+    if (needScreen)
+        viewfinders = ViewfinderIndex::build(resolutions, screen, memoryBudget);
+
+    if (viewfinderBench)
+    {
+        PhaseTimer phase("viewfinder-bench");
+        ViewfinderBench bench(&cr);
+
+        bench.setDuration(viewfinderDuration);
+        bench.run(cameras, resolutions, viewfinders);
+    }
+
+    {
+        PhaseTimer phase("plan");
+        plans = CameraPlan::build(cameras, resolutions, viewfinders, memoryBudget,
+                                  cameraPhotography);
+    }
+
+    if (jsonFilename.isEmpty() && blobFilename.isEmpty() && camhwTemplates.isEmpty())
+        og.dump(plans);
+
+    int ret = EXIT_SUCCESS;
 
     if (!jsonFilename.isEmpty())
-        og.makeJson(cameras, resolutions, app.primaryScreen()->availableGeometry(), jsonFilename);
+    {
+        PhaseTimer phase("output-json");
+        if (!og.makeJson(plans, jsonFilename))
+            ret = EXIT_FAILURE;
+    }
+
+    if (!blobFilename.isEmpty())
+    {
+        PhaseTimer phase("output-blob");
+        if (!og.makeBlob(plans, blobFilename))
+            ret = EXIT_FAILURE;
+    }
 
-    if (!camhwFilename.isEmpty())
-        og.makeCamhw(cameras, resolutions, app.primaryScreen()->availableGeometry(), camhwFilename);
+    if (!camhwTemplates.isEmpty())
+    {
+        PhaseTimer phase("output-camhw");
+        if (!og.makeCamhw(plans, camhwTemplates))
+            ret = EXIT_FAILURE;
+    }
+
+    if (timings)
+    {
+        Timings::instance()->print();
+        if (!Timings::instance()->write(timingsFilename))
+            ret = EXIT_FAILURE;
+    }
+
+    // A probe thread stuck in the camera HAL would block the normal exit
+    if (cr.abandoned())
+    {
+        fflush(stdout);
+        fflush(stderr);
+        _exit(ret);
+    }
 
-    return EXIT_SUCCESS;
+    return ret;
 }
@@ -0,0 +1,169 @@
+#include "minimalregistry.h"
+#include "probecache.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+
+#include <gst/gst.h>
+
+#ifndef GST_PLUGINS_DIR
+#define GST_PLUGINS_DIR "/usr/lib/gstreamer-1.0"
+#endif
+
+// Plugin files providing the elements used by ProbeSession. Not every
+// file exists in every GStreamer version, e.g. videoconvert and
+// videoscale were merged into videoconvertscale.
+static const char *probePlugins[] = {
+    "libgstcoreelements.so",
+    "libgstdroid.so",
+    // camresfixturesrc for --fixture, with the sources behind its pads
+    // and what its GstBaseCameraSrc base needs for previews
+    "libgstcamresfixture.so",
+    "libgstvideotestsrc.so",
+    "libgstapp.so"
+};
+
+static const char *pipelinePlugins[] = {
+    "libgstcamerabin.so",
+    "libgstencoding.so",
+    "libgstvideoconvert.so",
+    "libgstvideoscale.so",
+    "libgstvideoconvertscale.so",
+    "libgstisomp4.so",
+    "libgstvideotestsrc.so"
+};
+
+static const char *pipelineElements[] = {
+    "camerabin",
+    "fakesink",
+    "encodebin",
+    "videoconvert",
+    "videoscale"
+};
+
+// The plugin path of the environment, saved by prepare() before it is
+// cleared for gst_init()
+static QStringList userPluginDirs;
+
+static QStringList pluginDirs()
+{
+    QStringList dirs = userPluginDirs;
+
+    dirs << GST_PLUGINS_DIR;
+    dirs << "/usr/lib64/gstreamer-1.0";
+    dirs << "/usr/lib/gstreamer-1.0";
+    dirs.removeAll(QString());
+    dirs.removeDuplicates();
+
+    return dirs;
+}
+
+static void loadPlugins(const char **files, unsigned count, const QStringList &dirs)
+{
+    unsigned i;
+    int j;
+
+    for (i=0 ; i<count ; i++)
+    {
+        for (j=0 ; j<dirs.size() ; j++)
+        {
+            QFileInfo info(QDir(dirs.at(j)), files[i]);
+
+            if (!info.exists())
+                continue;
+
+            GError *error = NULL;
+            GstPlugin *plugin = gst_plugin_load_file(info.absoluteFilePath().toLocal8Bit().constData(), &error);
+
+            if (plugin)
+            {
+                gst_object_unref(plugin);
+            }
+            else
+            {
+                qWarning("Camres warning: Failed to load %s: %s", qPrintable(info.absoluteFilePath()), error->message);
+                g_error_free(error);
+            }
+            break;
+        }
+    }
+}
+
+static bool hasElement(const char *name)
+{
+    GstElementFactory *factory = gst_element_factory_find(name);
+
+    if (!factory)
+    {
+        return false;
+    }
+
+    gst_object_unref(factory);
+
+    return true;
+}
+
+void MinimalRegistry::prepare()
+{
+    QString registry = QFileInfo(ProbeCache::defaultFilename()).path() + "/registry-minimal.bin";
+
+    userPluginDirs = QString::fromLocal8Bit(qgetenv("GST_PLUGIN_PATH_1_0")).split(':', QString::SkipEmptyParts);
+    userPluginDirs += QString::fromLocal8Bit(qgetenv("GST_PLUGIN_PATH")).split(':', QString::SkipEmptyParts);
+
+    // GStreamer ignores GST_REGISTRY_UPDATE=no while the registry file
+    // does not exist yet and scans every plugin directory instead. With
+    // an empty search path that scan finds nothing, so the private
+    // registry stays empty and the system registry is never read. load()
+    // adds the plugins explicitly.
+    qputenv("GST_REGISTRY", registry.toLocal8Bit());
+    qputenv("GST_REGISTRY_UPDATE", "no");
+    qputenv("GST_REGISTRY_FORK", "no");
+    qputenv("GST_PLUGIN_SYSTEM_PATH_1_0", "");
+    qputenv("GST_PLUGIN_SYSTEM_PATH", "");
+    qunsetenv("GST_PLUGIN_PATH_1_0");
+    qunsetenv("GST_PLUGIN_PATH");
+}
+
+bool MinimalRegistry::load(const QByteArray &sourceElement, bool fastProbe, const QByteArray &encoder)
+{
+    QStringList dirs = pluginDirs();
+    bool ok = true;
+    unsigned i;
+
+    loadPlugins(probePlugins, sizeof(probePlugins)/sizeof(probePlugins[0]), dirs);
+    loadPlugins(pipelinePlugins, sizeof(pipelinePlugins)/sizeof(pipelinePlugins[0]), dirs);
+
+    if (!hasElement(sourceElement.constData()))
+    {
+        qCritical("Camres error: Element %s not found in %s.", sourceElement.constData(), qPrintable(dirs.join(':')));
+        ok = false;
+    }
+
+    for (i=0 ; i<sizeof(pipelineElements)/sizeof(pipelineElements[0]) ; i++)
+    {
+        if (hasElement(pipelineElements[i]))
+            continue;
+
+        if (fastProbe)
+        {
+            qWarning("Camres warning: Element %s not found, cameras that need camerabin cannot be probed.", pipelineElements[i]);
+        }
+        else
+        {
+            qCritical("Camres error: Element %s not found in %s.", pipelineElements[i], qPrintable(dirs.join(':')));
+            ok = false;
+        }
+    }
+
+    // Only the plugins above are loaded, there is no telling which file
+    // provides an arbitrary encoder
+    if (!encoder.isEmpty() && !hasElement(encoder.constData()))
+    {
+        qCritical("Camres error: Encoder %s is not provided by the plugins loaded with --minimal-registry.",
+                  encoder.constData());
+        ok = false;
+    }
+
+    return ok;
+}
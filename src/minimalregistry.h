@@ -0,0 +1,34 @@
+#ifndef MINIMALREGISTRY_H
+#define MINIMALREGISTRY_H
+
+#include <QByteArray>
+
+/*
+ * Starts GStreamer without scanning the system plugin directories.
+ *
+ * prepare() points GStreamer at a private registry and empties the
+ * plugin search path, so gst_init() neither reads the system registry
+ * nor finds anything to scan. load() then loads only the plugin files
+ * that provide the elements used for probing and checks that every
+ * needed element is available.
+ *
+ * The plugin files are searched in GST_PLUGIN_PATH_1_0 and
+ * GST_PLUGIN_PATH as they were before prepare(), the plugin directory
+ * GStreamer was built with and the usual library directories.
+ */
+class MinimalRegistry
+{
+public:
+    // Must be called before gst_init()
+    static void prepare();
+
+    // Loads the plugins for sourceElement and for camerabin. With
+    // fastProbe camerabin is only needed for cameras that do not report
+    // their caps before streaming, so its missing elements are warnings.
+    // encoder is the element given for --encode-bench, if any; it has to
+    // be provided by the loaded plugins. Reports every missing element
+    // and returns false if the probe cannot run at all.
+    static bool load(const QByteArray &sourceElement, bool fastProbe, const QByteArray &encoder = QByteArray());
+};
+
+#endif // MINIMALREGISTRY_H
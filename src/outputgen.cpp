@@ -1,263 +1,365 @@
 #include <stdio.h>
 #include <QFile>
 #include <QTextStream>
-#include <QMapIterator>
-#include <QRect>
+#include <QMap>
+#include <QHash>
 
 #include "outputgen.h"
-#include "camres.h"
+#include "outputsink.h"
+#include "camhwtemplate.h"
+#include "capabilityblob.h"
 
 #include <QDebug>
 
 #define S(n) QString(" ").repeated(n)
 
+// Sets prefixRES, and prefixFPS for video, when mode is valid
+static void insertMode(QHash<QString, QString> &map, QMap<QString, CamMode> &chosen,
+                       const QString &prefix, const CamMode &mode, bool framerate)
+{
+    if (!mode.isValid())
+    {
+        return;
+    }
+
+    map.insert(prefix + "RES", mode.resolution());
+    chosen.insert(prefix + "RES", mode);
+
+    // 30000/1001 counts as 30
+    if (framerate)
+        map.insert(prefix + "FPS", QString::number(qRound((double)mode.fpsMaxNum / mode.fpsMaxDen)));
+}
+
+// Sets key to the probed values, or to the template defaults when the
+// camera did not report any
+static void insertValues(QHash<QString, QString> &map, const QString &key,
+                         const QList<int> &values, const QList<int> &defaults)
+{
+    map.insert(key, Photography::format(values.isEmpty() ? defaults : values));
+}
+
+static void insertPhotography(QHash<QString, QString> &map, const QString &camKey, const CameraPlan &plan)
+{
+    const Photography &probed = plan.photography();
+    Photography defaults = Photography::defaults(camKey != "SEC");
+
+    if (probed.isEmpty())
+        qInfo("Camres: No photography capabilities for %s, using the defaults.", qPrintable(plan.name()));
+
+    insertValues(map, camKey + "ISOVALUES", probed.isoValues(), defaults.isoValues());
+    insertValues(map, camKey + "WHITEBALANCEVALUES", probed.whiteBalanceValues(), defaults.whiteBalanceValues());
+    insertValues(map, camKey + "FLASHVALUES", probed.flashValues(), defaults.flashValues());
+    insertValues(map, camKey + "VIDEOFLASHVALUES", probed.videoFlashValues(), defaults.videoFlashValues());
+    insertValues(map, camKey + "FOCUSVALUES", probed.focusValues(), defaults.focusValues());
+    insertValues(map, camKey + "VIDEOFOCUSVALUES", probed.videoFocusValues(), defaults.videoFocusValues());
+    insertValues(map, camKey + "EXPOSUREVALUES", probed.exposureValues(), defaults.exposureValues());
+    map.insert(camKey + "FOCUSDISTANCE", QString::number(probed.focusDistance() >= 0 ?
+                                                         probed.focusDistance() : defaults.focusDistance()));
+    map.insert(camKey + "VIDEOFOCUSDISTANCE", QString::number(probed.focusDistance(true) >= 0 ?
+                                                              probed.focusDistance(true) : defaults.focusDistance(true)));
+}
+
 OutputGen::OutputGen(QObject *parent) :
     QObject(parent)
 {
 }
 
-void OutputGen::dump(const QList<QPair<QString, int> > &cameras, const QList<QList<QPair<QString, QStringList> > > &resolutions)
+void OutputGen::dump(const QList<CameraPlan> &plans)
 {
     int i, j, m;
 
-    for (i=0 ; i<cameras.size() ; i++)
+    for (i=0 ; i<plans.size() ; i++)
     {
-        if (resolutions.at(i).isEmpty())
+        const CameraPlan &plan = plans.at(i);
+
+        if (plan.isEmpty())
         {
-            qCritical("Camres warning: No resolutions found for %s (%d):", qPrintable(cameras.at(i).first), cameras.at(i).second);
+            qCritical("Camres warning: No resolutions found for %s (%d):", qPrintable(plan.name()), plan.device());
             continue;
         }
 
-        qInfo("\nResolutions for %s:", qPrintable(cameras.at(i).first));
+        qInfo("\nResolutions for %s:", qPrintable(plan.name()));
 
-        for (j=0 ; j<resolutions.at(i).size() ; j++)
+        for (j=0 ; j<plan.lists().size() ; j++)
         {
-            qInfo("%s resolutions:", qPrintable(resolutions.at(i).at(j).first.split("-").first()));
+            const PlanList &list = plan.lists().at(j);
 
-            QStringList res = resolutions.at(i).at(j).second;
+            qInfo("%s resolutions:", qPrintable(list.caps.split("-").first()));
 
-            for (m=0 ; m<res.size() ; m++)
+            for (m=0 ; m<list.modes.size() ; m++)
             {
-                qInfo("%s (%s)", qPrintable(res.at(m)), qPrintable(Camres::aspectRatioForResolution(res.at(m))));
+                const PlanMode &planned = list.modes.at(m);
+
+                if (list.kind == CamMode::Viewfinder && planned.stats.isValid())
+                    qInfo("%s (%s) %.1f fps, %.2f ms jitter, first frame %.0f ms", qPrintable(planned.mode.toString()),
+                          planned.aspect->name, planned.stats.fps, planned.stats.jitterMs, planned.stats.firstFrameMs);
+                else
+                    qInfo("%s (%s)", qPrintable(planned.mode.toString()), planned.aspect->name);
             }
         }
+
+        if (!plan.tiers().isEmpty())
+            qInfo("video tiers:");
+
+        for (m=0 ; m<plan.tiers().size() ; m++)
+            qInfo("%d fps: %s", plan.tiers().at(m).fps, qPrintable(plan.tiers().at(m).mode.toString()));
+
+        const Photography &photography = plan.photography();
+
+        if (!photography.isEmpty())
+        {
+            qInfo("photography:");
+            qInfo("iso: %s", qPrintable(Photography::format(photography.isoValues())));
+            qInfo("white balance: %s", qPrintable(Photography::format(photography.whiteBalanceValues())));
+            qInfo("flash: %s, video %s", qPrintable(Photography::format(photography.flashValues())),
+                  qPrintable(Photography::format(photography.videoFlashValues())));
+            qInfo("focus: %s, video %s", qPrintable(Photography::format(photography.focusValues())),
+                  qPrintable(Photography::format(photography.videoFocusValues())));
+            qInfo("exposure compensation: %s", qPrintable(Photography::format(photography.exposureValues())));
+        }
     }
 }
 
-void OutputGen::makeJson(const QList<QPair<QString, int> > &cameras,
-                         const QList<QList<QPair<QString, QStringList> > > &resolutions,
-                         const QRect &screenGeometry,
-                         const QString &filename)
+bool OutputGen::makeJson(const QList<CameraPlan> &plans, const QString &filename)
 {
-    int i, j, m;
-    QFile file;
-    QTextStream *ts = NULL;
+    OutputSink sink(filename);
 
-    file.setFileName(filename);
+    qInfo("Camres: Writing json to file %s", qPrintable(sink.fileName()));
 
-    if ( !file.open(QIODevice::ReadWrite | QIODevice::Truncate | QIODevice::Text))
-    {
-        qCritical("Camres error: Could not create output file.");
-        return;
-    }
+    writeJson(plans, sink.stream());
 
-    ts = new QTextStream(&file);
+    return sink.commit();
+}
 
-    qInfo("Camres: Writing json to file %s", qPrintable(file.fileName()));
+void OutputGen::writeJson(const QList<CameraPlan> &plans, QTextStream &stream)
+{
+    int i, j, m;
+    bool firstCamera = true;
+    QTextStream *ts = &stream;
 
-    *ts << "{" << endl;
+    *ts << "{" << '\n';
 
-    for (i=0 ; i<cameras.size() ; i++)
+    for (i=0 ; i<plans.size() ; i++)
     {
-        if (resolutions.at(i).isEmpty())
+        const CameraPlan &plan = plans.at(i);
+
+        if (plan.isEmpty())
         {
-            qWarning("Camres warning: No resolutions found for %s (%d): Configuration not set.", qPrintable(cameras.at(i).first), cameras.at(i).second);
+            qWarning("Camres warning: No resolutions found for %s (%d): Configuration not set.", qPrintable(plan.name()), plan.device());
             continue;
         }
 
-        if (i>0)
-            *ts << "," << endl;
+        if (!firstCamera)
+            *ts << "," << '\n';
+        firstCamera = false;
 
-        *ts << S(4) << "\"" << cameras.at(i).first.split(" ").first().toLower() << "\":" << endl << S(4) << "{" << endl;
+        *ts << S(4) << "\"" << plan.name().split(" ").first().toLower() << "\":" << '\n' << S(4) << "{" << '\n';
 
-        for (j=0 ; j<resolutions.at(i).size() ; j++)
+        bool firstKind = true;
+
+        for (j=0 ; j<plan.lists().size() ; j++)
         {
-            if (resolutions.at(i).at(j).first.startsWith("viewfinder"))
+            const PlanList &list = plan.lists().at(j);
+
+            if (list.kind == CamMode::Viewfinder)
             {
                 continue;
             }
 
-            if (j>0)
-                *ts << "," << endl;
-
-            QStringList res = resolutions.at(i).at(j).second;
+            if (!firstKind)
+                *ts << "," << '\n';
+            firstKind = false;
 
-            *ts << S(8) << "\"" << resolutions.at(i).at(j).first.split("-").first().toLower() << "\":" << endl << S(8) << "[" << endl;
-            QStringList repeatCheck;
-            for (m=0 ; m<res.size() ; m++)
+            *ts << S(8) << "\"" << list.caps.split("-").first().toLower() << "\":" << '\n' << S(8) << "[" << '\n';
+            for (m=0 ; m<list.offered.size() ; m++)
             {
-                QString thisRes = res.at(m).split('@').first();
-                if (repeatCheck.contains(thisRes)) continue;
-                *ts << S(12) << "{ \"resolution\": \"" << thisRes << "\", "
-                   << "\"viewFinder\": \"" << Camres::findBestViewFinderForResolution(thisRes, resolutions.at(i), screenGeometry) << "\", "
-                   << "\"aspectRatio\": \"" << Camres::aspectRatioForResolution(thisRes) << "\" }"
-                   << ((m == res.size()-1) ? "" : ",") << endl;
-                repeatCheck << thisRes;
+                const PlanMode &planned = list.offered.at(m);
+                if (m > 0)
+                    *ts << "," << '\n';
+                *ts << S(12) << "{ \"resolution\": \"" << planned.mode.resolution() << "\", "
+                   << "\"viewFinder\": \"" << (planned.viewfinder.isValid() ? planned.viewfinder.resolution() : QString("?:?")) << "\", ";
+                if (planned.stats.isValid())
+                    *ts << "\"viewFinderFps\": " << QString::number(planned.stats.fps, 'f', 1) << ", "
+                       << "\"viewFinderJitterMs\": " << QString::number(planned.stats.jitterMs, 'f', 2) << ", "
+                       << "\"viewFinderFirstFrameMs\": " << QString::number(planned.stats.firstFrameMs, 'f', 0) << ", ";
+                *ts << "\"aspectRatio\": \"" << planned.aspect->name << "\" }";
             }
 
-            *ts << S(8) << "]";
+            *ts << '\n' << S(8) << "]";
         }
 
-        *ts << endl;
-        *ts << S(4) << "}";
-    }
+        const QList<VideoTier> &tiers = plan.tiers();
 
-    *ts << endl;
-    *ts << "}" << endl;
-
-    file.close();
-}
+        if (!tiers.isEmpty())
+        {
+            if (!firstKind)
+                *ts << "," << '\n';
 
-void OutputGen::makeCamhw(const QList<QPair<QString, int> > &cameras,
-                          const QList<QList<QPair<QString, QStringList> > > &resolutions,
-                          const QRect &screenGeometry,
-                          const QString &filename)
-{
-    int i, j, m;
+            *ts << S(8) << "\"videoTiers\":" << '\n' << S(8) << "[" << '\n';
+            for (m=0 ; m<tiers.size() ; m++)
+            {
+                const CamMode &mode = tiers.at(m).mode;
+                *ts << S(12) << "{ \"fps\": " << tiers.at(m).fps << ", "
+                   << "\"resolution\": \"" << mode.resolution() << "\", "
+                   << "\"framerate\": \"" << mode.fpsNum << "/" << mode.fpsDen << "\", "
+                   << "\"aspectRatio\": \"" << AspectRatio::classify(mode).name << "\" }"
+                   << (m == tiers.size()-1 ? "" : ",") << '\n';
+            }
+            *ts << S(8) << "]";
+            firstKind = false;
+        }
 
-    QMap<QString, QString> map;
+        const Photography &photography = plan.photography();
 
-    QFile file;
-    QTextStream *ts = NULL;
-    file.setFileName(filename);
+        if (!photography.isEmpty())
+        {
+            if (!firstKind)
+                *ts << "," << '\n';
+
+            *ts << S(8) << "\"photography\":" << '\n' << S(8) << "{" << '\n'
+               << S(12) << "\"isoValues\": " << Photography::format(photography.isoValues()) << "," << '\n'
+               << S(12) << "\"whiteBalanceValues\": " << Photography::format(photography.whiteBalanceValues()) << "," << '\n'
+               << S(12) << "\"flashValues\": " << Photography::format(photography.flashValues()) << "," << '\n'
+               << S(12) << "\"videoFlashValues\": " << Photography::format(photography.videoFlashValues()) << "," << '\n'
+               << S(12) << "\"focusDistanceValues\": " << Photography::format(photography.focusValues()) << "," << '\n'
+               << S(12) << "\"videoFocusDistanceValues\": " << Photography::format(photography.videoFocusValues()) << "," << '\n'
+               << S(12) << "\"exposureCompensationValues\": " << Photography::format(photography.exposureValues()) << '\n'
+               << S(8) << "}";
+        }
 
-    if ( !file.open(QIODevice::ReadWrite | QIODevice::Truncate | QIODevice::Text))
-    {
-        qCritical("Camres error: Could not create output file.");
-        return;
+        *ts << '\n';
+        *ts << S(4) << "}";
     }
 
-    ts = new QTextStream(&file);
+    *ts << '\n';
+    *ts << "}" << '\n';
+}
 
-    qInfo("Camres: Writing dconf settings to file %s", qPrintable(file.fileName()));
+bool OutputGen::makeBlob(const QList<CameraPlan> &plans, const QString &filename)
+{
+    OutputSink sink(filename);
 
-    QFile resfile("/usr/share/droid-camres/jolla-camera-hw-template.txt");
-    QStringList camhwTemplate;
+    qInfo("Camres: Writing capability blob to file %s", qPrintable(sink.fileName()));
 
-    if (!resfile.open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        qCritical("Camres error: failed to open template");
-        return;
-    }
+    sink.write(CapabilityBlob::build(plans));
 
-    QTextStream rests(&resfile);
+    return sink.commit();
+}
 
-    while(!rests.atEnd())
-    {
-        camhwTemplate.append(rests.readLine());
-    }
+QHash<QString, QString> OutputGen::camhwValues(const QList<CameraPlan> &plans)
+{
+    const AspectRatio &ratio43 = AspectRatio::classify(4, 3);
+    const AspectRatio &ratio169 = AspectRatio::classify(16, 9);
+    int i, j, m;
 
-    resfile.close();
+    QHash<QString, QString> map;
+    QMap<QString, CamMode> chosen;
+    bool reportMemory = false;
 
-    for (i=0 ; i<cameras.size() ; i++)
+    for (i=0 ; i<plans.size() ; i++)
     {
-        if (resolutions.at(i).isEmpty())
+        const CameraPlan &plan = plans.at(i);
+
+        if (plan.isEmpty())
         {
-            qWarning("Camres warning: No resolutions found for %s (%d): Configuration not set.", qPrintable(cameras.at(i).first), cameras.at(i).second);
+            qWarning("Camres warning: No resolutions found for %s (%d): Configuration not set.", qPrintable(plan.name()), plan.device());
             continue;
         }
 
-        QString camKey = cameras.at(i).first.left(3).toUpper();
-        for (j=0 ; j<resolutions.at(i).size() ; j++)
-        {
-            QString resType = resolutions.at(i).at(j).first;
-            QStringList res = resolutions.at(i).at(j).second;
-            QString prefix;
-            bool isVideo = false;
+        QString camKey = plan.name().left(3).toUpper();
+        reportMemory = reportMemory || plan.memoryBudget() >= 0;
 
-            if (resType.startsWith("viewfinder"))
-            {
-                prefix = "@" + camKey + "VF";
-            }
-            else if (resType.startsWith("image"))
-            {
-                prefix = "@" + camKey + "IMAGE";
-            }
-            else if (resType.startsWith("video"))
-            {
-                prefix = "@" + camKey + "VIDEO";
-                isVideo = true;
-            }
-            else continue; // unknown resolution type
+        insertPhotography(map, camKey, plan);
 
-            QMap<QString, int> sizes;
-            int topFramerate = 0;
-            for (m=0 ; m<res.size() ; m++)
+        for (j=0 ; j<plan.lists().size() ; j++)
+        {
+            switch (plan.lists().at(j).kind)
             {
-                QList<QString> resBits = res.at(m).split(QRegExp("[x@\\-\\/]"));
-                int size = resBits.at(0).toInt() * resBits.at(1).toInt();
-                if (!resType.startsWith("viewfinder") || (
-                    qMin(screenGeometry.height(), screenGeometry.width()) >=
-                    qMin(resBits.at(0).toInt(), resBits.at(1).toInt()) &&
-                    qMax(screenGeometry.height(), screenGeometry.width()) >=
-                    qMax(resBits.at(0).toInt(), resBits.at(1).toInt())))
+            case CamMode::Viewfinder:
+                insertMode(map, chosen, camKey + "VF43", plan.viewfinder(ratio43), false);
+                insertMode(map, chosen, camKey + "VF169", plan.viewfinder(ratio169), false);
+                break;
+            case CamMode::Image:
+                insertMode(map, chosen, camKey + "IMAGE43", plan.image(ratio43), false);
+                insertMode(map, chosen, camKey + "IMAGE169", plan.image(ratio169), false);
+                break;
+            case CamMode::Video:
+                // only 16:9 video is offered in the camera app
+                insertMode(map, chosen, camKey + "VIDEO", plan.video(ratio169), true);
+                for (m=0 ; m<plan.tiers().size() ; m++)
                 {
-                    QString aspect = "";
-                    if (Camres::aspectRatioForResolution(res.at(m)).compare("4:3") == 0)
-                    {
-                        if (isVideo) continue;
-                        aspect = "43";
-                    }
-                    else if (Camres::aspectRatioForResolution(res.at(m)).compare("16:9") == 0)
-                    {
-                        if (!isVideo) aspect = "169";
-                    }
-                    else continue;
-                    int framerate = 0;
-                    if (isVideo)
-                    {
-                        switch (resBits.size())
-                        {
-                        case 4:
-                            framerate = resBits.at(2).toInt()/resBits.at(3).toInt();
-                            break;
-                        case 6: // take the top of the range
-                            framerate = resBits.at(4).toInt()/resBits.at(5).toInt();
-                            break;
-                        default:
-                            // video framerate without fps. skip
-                            continue;
-                        }
-                    }
-                    QString key = prefix + aspect + "RES@";
-                    if ((map.value(key).isEmpty() || size >= sizes.value(key)) && framerate >= topFramerate)
-                    {
-                        map.insert(key, resBits.at(0)+"x"+resBits.at(1));
-                        sizes.insert(key, size);
-                        if (isVideo)
-                        {
-                            map.insert(prefix+"FPS@", QString::number(framerate));
-                            topFramerate = framerate;
-                        }
-                    }
+                    const CamMode &mode = plan.tiers().at(m).mode;
+                    QString prefix = camKey + "VIDEO" + QString::number(plan.tiers().at(m).fps);
+
+                    insertMode(map, chosen, prefix, mode, true);
+                    map.insert(prefix + "FRAMERATE", QString("%1/%2").arg(mode.fpsNum).arg(mode.fpsDen));
                 }
+                break;
+            default:
+                break; // unknown resolution type
             }
         }
     }
 
-    QMapIterator<QString, QString> k(map);
+    if (reportMemory)
+    {
+        for (QMap<QString, CamMode>::const_iterator it = chosen.constBegin(); it != chosen.constEnd(); ++it)
+        {
+            qInfo("Camres: %s %s %s: %d buffers, about %.1f MB", qPrintable(it.key()),
+                  qPrintable(it.value().resolution()),
+                  it.value().format.isEmpty() ? "?" : it.value().format.constData(),
+                  it.value().expectedBuffers(), it.value().footprint() / (1024.0 * 1024.0));
+        }
+    }
+
+    return map;
+}
+
+static bool writeCamhw(const CamhwTemplate &camhwTemplate, const QHash<QString, QString> &map, const QString &filename)
+{
+    QStringList unresolved;
+    int j;
+
+    OutputSink sink(filename);
+
+    qInfo("Camres: Writing dconf settings to file %s", qPrintable(sink.fileName()));
+
+    sink.stream() << camhwTemplate.render(map, &unresolved);
+
+    for (j=0 ; j<unresolved.size() ; j++)
+        qCritical("Camres error: Not found suitable resolution for %s in %s. Check output!",
+                  qPrintable(unresolved.at(j)), qPrintable(camhwTemplate.fileName()));
 
-    while (k.hasNext())
+    return sink.commit();
+}
+
+bool OutputGen::makeCamhw(const QList<CameraPlan> &plans,
+                          const QList<QPair<QString, QString> > &templates)
+{
+    QHash<QString, QString> map = camhwValues(plans);
+    int i;
+    bool ok = true;
+
+    for (i=0 ; i<templates.size() ; i++)
     {
-        k.next();
-        if (k.value().isEmpty())
-            qCritical("Camres error: Not found suitable resolution for %s. Check output!", qPrintable(k.key()));
-        else
-            camhwTemplate.replaceInStrings(k.key(), k.value());
+        CamhwTemplate camhwTemplate;
+
+        if (!camhwTemplate.load(templates.at(i).first))
+        {
+            qCritical("Camres error: failed to open template %s", qPrintable(templates.at(i).first));
+            ok = false;
+            continue;
+        }
+
+        if (!writeCamhw(camhwTemplate, map, templates.at(i).second))
+            ok = false;
     }
 
-    for (i=0 ; i<camhwTemplate.size() ; i++)
-        *ts << camhwTemplate.at(i) << endl;
+    return ok;
+}
 
-    file.close();
+bool OutputGen::makeCamhw(const QList<CameraPlan> &plans,
+                          const CamhwTemplate &camhwTemplate, const QString &filename)
+{
+    return writeCamhw(camhwTemplate, camhwValues(plans), filename);
 }
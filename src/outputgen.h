@@ -2,25 +2,39 @@
 #define OUTPUTGEN_H
 
 #include <QObject>
+#include <QHash>
+#include <QTextStream>
 
+#include "cameraplan.h"
+#include "camhwtemplate.h"
+
+#define CAMHW_TEMPLATE "/usr/share/droid-camres/jolla-camera-hw-template.txt"
+
+/*
+ * Serialises camera plans. All choices are made in CameraPlan.
+ */
 class OutputGen : public QObject
 {
     Q_OBJECT
 public:
     explicit OutputGen(QObject *parent = 0);
 
-    void dump(const QList<QPair<QString, int> >& cameras,
-              const QList<QList<QPair<QString, QStringList> > >& resolutions);
+    void dump(const QList<CameraPlan>& plans);
+
+    bool makeJson(const QList<CameraPlan>& plans, const QString& filename);
+    void writeJson(const QList<CameraPlan>& plans, QTextStream& stream);
 
-    void makeJson(const QList<QPair<QString, int> >& cameras,
-                  const QList<QList<QPair<QString, QStringList> > >& resolutions,
-                  const QRect& screenGeometry,
-                  const QString& filename);
+    // See camresblob.h
+    bool makeBlob(const QList<CameraPlan>& plans, const QString& filename);
 
-    void makeCamhw(const QList<QPair<QString, int> >& cameras,
-                   const QList<QList<QPair<QString, QStringList> > >& resolutions,
-                   const QRect& screenGeometry,
-                   const QString& filename);
+    // templates holds pairs of template and output filename
+    bool makeCamhw(const QList<CameraPlan>& plans,
+                   const QList<QPair<QString, QString> >& templates);
+    // Renders an already loaded template into filename
+    bool makeCamhw(const QList<CameraPlan>& plans,
+                   const CamhwTemplate& camhwTemplate, const QString& filename);
+    // The values of the template keys, see CamhwTemplate::render()
+    QHash<QString, QString> camhwValues(const QList<CameraPlan>& plans);
 };
 
 #endif // OUTPUTGEN_H
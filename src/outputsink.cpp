@@ -0,0 +1,66 @@
+#include "outputsink.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QCryptographicHash>
+
+OutputSink::OutputSink(const QString &filename) :
+    m_filename(filename),
+    m_stream(&m_buffer, QIODevice::WriteOnly)
+{
+}
+
+QTextStream &OutputSink::stream()
+{
+    return m_stream;
+}
+
+void OutputSink::write(const QByteArray &data)
+{
+    m_stream.flush();
+    m_stream.device()->write(data);
+}
+
+QString OutputSink::fileName() const
+{
+    return m_filename;
+}
+
+bool OutputSink::commit()
+{
+    m_stream.flush();
+
+    QFile current(m_filename);
+
+    if (current.size() == m_buffer.size() && current.open(QIODevice::ReadOnly))
+    {
+        QCryptographicHash currentHash(QCryptographicHash::Sha1);
+
+        if (currentHash.addData(&current) &&
+            currentHash.result() == QCryptographicHash::hash(m_buffer, QCryptographicHash::Sha1))
+        {
+            qInfo("Camres: %s is up to date", qPrintable(m_filename));
+            return true;
+        }
+
+        current.close();
+    }
+
+    // QSaveFile writes to a temporary file, syncs it and renames it over
+    // the target on commit()
+    QSaveFile file(m_filename);
+
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qCritical("Camres error: Could not create output file %s: %s", qPrintable(m_filename), qPrintable(file.errorString()));
+        return false;
+    }
+
+    if (file.write(m_buffer) != m_buffer.size() || !file.commit())
+    {
+        qCritical("Camres error: Could not write output file %s: %s", qPrintable(m_filename), qPrintable(file.errorString()));
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef OUTPUTSINK_H
+#define OUTPUTSINK_H
+
+#include <QString>
+#include <QByteArray>
+#include <QTextStream>
+
+/*
+ * Collects a generated document in memory and replaces the target file
+ * in one go on commit(). The document is written to a temporary file,
+ * synced and renamed over the target, so readers never see a partial
+ * file. Nothing is written when the target already has the same content.
+ */
+class OutputSink
+{
+public:
+    explicit OutputSink(const QString &filename);
+
+    QTextStream &stream();
+    // For binary documents
+    void write(const QByteArray &data);
+    QString fileName() const;
+
+    bool commit();
+
+private:
+    Q_DISABLE_COPY(OutputSink)
+
+    QString m_filename;
+    QByteArray m_buffer;
+    QTextStream m_stream;
+};
+
+#endif // OUTPUTSINK_H
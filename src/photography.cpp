@@ -0,0 +1,439 @@
+#include "photography.h"
+
+#include <QStringList>
+#include <qmath.h>
+
+#define ISO_KEY "iso"
+#define WHITE_BALANCE_KEY "white-balance"
+#define FLASH_KEY "flash"
+#define FOCUS_KEY "focus"
+#define EV_KEY "ev-compensation"
+
+struct NickValue
+{
+    const char *nick;
+    int value;
+};
+
+// GstPhotographyWhiteBalanceMode to QCameraImageProcessing::WhiteBalanceMode.
+// The Android names are accepted too, in case the element passes them on.
+static const NickValue whiteBalanceModes[] = {
+    { "auto", 0 },
+    { "manual", 1 },
+    { "daylight", 2 },
+    { "cloudy", 3 },
+    { "shade", 4 },
+    { "tungsten", 5 },
+    { "fluorescent", 6 },
+    { "warm-fluorescent", 6 },
+    { "sunset", 8 },
+    { "incandescent", 5 },
+    { "cloudy-daylight", 3 },
+    { "twilight", 8 },
+    { NULL, 0 }
+};
+
+// GstPhotographyFlashMode to QCameraExposure::FlashMode
+static const NickValue flashModes[] = {
+    { "auto", 0x1 },
+    { "off", 0x2 },
+    { "on", 0x4 },
+    { "red-eye", 0x8 },
+    { "fill-in", 0x10 },
+    { "torch", 0x20 },
+    { NULL, 0 }
+};
+
+// GstPhotographyFocusMode to QCameraFocus::FocusMode
+static const NickValue focusModes[] = {
+    { "manual", 0x1 },
+    { "hyperfocal", 0x2 },
+    { "infinity", 0x4 },
+    { "auto", 0x8 },
+    { "continuous-normal", 0x10 },
+    { "continuous-extended", 0x10 },
+    { "macro", 0x20 },
+    { "fixed", 0x4 },
+    { "continuous-picture", 0x10 },
+    { "continuous-video", 0x10 },
+    { NULL, 0 }
+};
+
+static const int FlashOff = 0x2;
+static const int FlashTorch = 0x20;
+static const int InfinityFocus = 0x4;
+static const int AutoFocus = 0x8;
+static const int ContinuousFocus = 0x10;
+
+// Values of the nicks in order, without duplicates or unknown nicks
+static QList<int> mapNicks(const QStringList &nicks, const NickValue *table)
+{
+    QList<int> res;
+    int i, t;
+
+    for (i=0 ; i<nicks.size() ; i++)
+    {
+        for (t=0 ; table[t].nick ; t++)
+        {
+            if (nicks.at(i) == table[t].nick && !res.contains(table[t].value))
+                res.append(table[t].value);
+        }
+    }
+
+    return res;
+}
+
+static void appendValue(const GValue *value, GEnumClass *enumClass, QStringList &res)
+{
+    if (G_VALUE_HOLDS_STRING(value))
+    {
+        QStringList items = QString::fromUtf8(g_value_get_string(value)).split(',', QString::SkipEmptyParts);
+        int i;
+
+        for (i=0 ; i<items.size() ; i++)
+            res.append(items.at(i).trimmed());
+    }
+    else if (G_VALUE_HOLDS_ENUM(value))
+    {
+        GEnumClass *valueClass = G_ENUM_CLASS(g_type_class_ref(G_VALUE_TYPE(value)));
+        GEnumValue *e = g_enum_get_value(valueClass, g_value_get_enum(value));
+
+        if (e)
+            res.append(e->value_nick);
+        g_type_class_unref(valueClass);
+    }
+    else if (g_value_type_transformable(G_VALUE_TYPE(value), G_TYPE_INT))
+    {
+        GValue number = G_VALUE_INIT;
+        g_value_init(&number, G_TYPE_INT);
+        g_value_transform(value, &number);
+
+        // Plain numbers stand for values of the mode enum, if there is one
+        GEnumValue *e = enumClass ? g_enum_get_value(enumClass, g_value_get_int(&number)) : NULL;
+
+        if (e)
+            res.append(e->value_nick);
+        else if (!enumClass)
+            res.append(QString::number(g_value_get_int(&number)));
+        g_value_unset(&number);
+    }
+}
+
+static void appendValues(const GValue *value, GEnumClass *enumClass, QStringList &res)
+{
+    guint i;
+
+    if (GST_VALUE_HOLDS_ARRAY(value))
+    {
+        for (i=0 ; i<gst_value_array_get_size(value) ; i++)
+            appendValue(gst_value_array_get_value(value, i), enumClass, res);
+    }
+    else if (GST_VALUE_HOLDS_LIST(value))
+    {
+        for (i=0 ; i<gst_value_list_get_size(value) ; i++)
+            appendValue(gst_value_list_get_value(value, i), enumClass, res);
+    }
+    else if (G_VALUE_HOLDS(value, G_TYPE_STRV))
+    {
+        gchar **strv = (gchar **)g_value_get_boxed(value);
+
+        for (i=0 ; strv && strv[i] ; i++)
+            res.append(QString::fromUtf8(strv[i]));
+    }
+    else if (G_VALUE_HOLDS_VARIANT(value))
+    {
+        GVariant *variant = g_value_get_variant(value);
+
+        if (variant && g_variant_is_of_type(variant, G_VARIANT_TYPE("ai")))
+        {
+            for (i=0 ; i<g_variant_n_children(variant) ; i++)
+            {
+                GValue number = G_VALUE_INIT;
+                GVariant *child = g_variant_get_child_value(variant, i);
+
+                g_value_init(&number, G_TYPE_INT);
+                g_value_set_int(&number, g_variant_get_int32(child));
+                appendValue(&number, enumClass, res);
+                g_value_unset(&number);
+                g_variant_unref(child);
+            }
+        }
+        else if (variant && g_variant_is_of_type(variant, G_VARIANT_TYPE("as")))
+        {
+            for (i=0 ; i<g_variant_n_children(variant) ; i++)
+            {
+                GVariant *child = g_variant_get_child_value(variant, i);
+                res.append(QString::fromUtf8(g_variant_get_string(child, NULL)));
+                g_variant_unref(child);
+            }
+        }
+    }
+    else
+    {
+        appendValue(value, enumClass, res);
+    }
+}
+
+static GParamSpec *findProperty(GstElement *source, const char *property)
+{
+    GParamSpec *spec = g_object_class_find_property(G_OBJECT_GET_CLASS(source), property);
+
+    // Properties of GstPhotography are overridden by the element
+    if (spec && g_param_spec_get_redirect_target(spec))
+        spec = g_param_spec_get_redirect_target(spec);
+
+    return spec;
+}
+
+// The supported list of the element, empty when it has none. Numbers in
+// the list are taken as values of the enum of modeProperty.
+static QStringList readSupported(GstElement *source, const char *property, const char *modeProperty)
+{
+    GParamSpec *mode = modeProperty ? findProperty(source, modeProperty) : NULL;
+    GEnumClass *enumClass = mode && G_IS_PARAM_SPEC_ENUM(mode) ? G_PARAM_SPEC_ENUM(mode)->enum_class : NULL;
+    GParamSpec *spec = findProperty(source, property);
+    QStringList res;
+
+    if (spec && (spec->flags & G_PARAM_READABLE))
+    {
+        GValue value = G_VALUE_INIT;
+        g_value_init(&value, spec->value_type);
+        g_object_get_property(G_OBJECT(source), property, &value);
+        appendValues(&value, enumClass, res);
+        g_value_unset(&value);
+    }
+
+    res.removeDuplicates();
+
+    return res;
+}
+
+static bool readDouble(GstElement *source, const char *property, double *res)
+{
+    GParamSpec *spec = findProperty(source, property);
+
+    if (!spec || !(spec->flags & G_PARAM_READABLE) ||
+        !g_value_type_transformable(spec->value_type, G_TYPE_DOUBLE))
+    {
+        return false;
+    }
+
+    GValue value = G_VALUE_INIT;
+    GValue number = G_VALUE_INIT;
+
+    g_value_init(&value, spec->value_type);
+    g_value_init(&number, G_TYPE_DOUBLE);
+    g_object_get_property(G_OBJECT(source), property, &value);
+    g_value_transform(&value, &number);
+    *res = g_value_get_double(&number);
+    g_value_unset(&number);
+    g_value_unset(&value);
+
+    return true;
+}
+
+static QList<int> parseInts(const QString &value)
+{
+    QStringList items = value.split(',', QString::SkipEmptyParts);
+    QList<int> res;
+    int i;
+
+    for (i=0 ; i<items.size() ; i++)
+    {
+        bool ok;
+        int n = items.at(i).trimmed().toInt(&ok);
+
+        if (ok && !res.contains(n))
+            res.append(n);
+    }
+
+    return res;
+}
+
+Photography::Photography()
+{
+}
+
+Photography::Photography(const QList<QPair<QString, QString> > &values) :
+    m_values(values)
+{
+    int i;
+
+    for (i=0 ; i<values.size() ; i++)
+    {
+        const QString &key = values.at(i).first;
+        QStringList nicks = values.at(i).second.split(',', QString::SkipEmptyParts);
+
+        if (key == ISO_KEY)
+        {
+            m_iso = parseInts(values.at(i).second);
+            qSort(m_iso);
+        }
+        else if (key == WHITE_BALANCE_KEY)
+        {
+            m_whiteBalance = mapNicks(nicks, whiteBalanceModes);
+        }
+        else if (key == FLASH_KEY)
+        {
+            m_flash = mapNicks(nicks, flashModes);
+            m_flash.removeAll(FlashTorch);
+
+            // The camera app only switches the torch on or off in video
+            m_videoFlash.append(FlashOff);
+            if (nicks.contains("torch"))
+                m_videoFlash.append(FlashTorch);
+        }
+        else if (key == FOCUS_KEY)
+        {
+            m_focus = mapNicks(nicks, focusModes);
+
+            // Single autofocus is not used while recording
+            m_videoFocus = m_focus;
+            m_videoFocus.removeAll(AutoFocus);
+            if (m_videoFocus.isEmpty())
+                m_videoFocus = m_focus;
+        }
+        else if (key == EV_KEY)
+        {
+            QList<int> steps = parseInts(values.at(i).second);
+            int s;
+
+            qSort(steps);
+            for (s=steps.size()-1 ; s>=0 ; s--)
+                m_exposure.append(steps.at(s) * 2);
+        }
+    }
+}
+
+Photography Photography::defaults(bool primary)
+{
+    Photography res;
+
+    res.m_iso << 0 << 100 << 200 << 400 << 800 << 1600 << 3200;
+    res.m_whiteBalance << 0 << 3 << 2 << 6 << 5;
+    res.m_exposure << 4 << 2 << 0 << -2 << -4;
+
+    if (primary)
+    {
+        res.m_flash << 1 << 2 << 4;
+        res.m_videoFlash << 2 << 32;
+        res.m_focus << 8 << 4 << 16;
+        res.m_videoFocus << 4 << 16;
+    }
+    else
+    {
+        res.m_flash << 2;
+        res.m_videoFlash << 2;
+        res.m_focus << 4;
+        res.m_videoFocus << 4;
+    }
+
+    return res;
+}
+
+Photography Photography::probe(GstElement *source)
+{
+    QList<QPair<QString, QString> > res;
+    QStringList values;
+    double min, max;
+
+    values = readSupported(source, "supported-iso-speeds", NULL);
+    if (!values.isEmpty())
+    {
+        QStringList iso;
+        int i;
+
+        // Android reports e.g. auto,ISO100,ISO200
+        for (i=0 ; i<values.size() ; i++)
+        {
+            QString v = values.at(i);
+            bool ok;
+            int n;
+
+            if (v.compare("auto", Qt::CaseInsensitive) == 0)
+                v = "0";
+            else if (v.startsWith("ISO", Qt::CaseInsensitive))
+                v = v.mid(3);
+
+            n = v.toInt(&ok);
+            if (ok && n >= 0)
+                iso.append(QString::number(n));
+        }
+
+        if (!iso.isEmpty())
+            res.append(qMakePair(QString(ISO_KEY), iso.join(",")));
+    }
+
+    values = readSupported(source, "supported-wb-modes", "white-balance-mode");
+    if (!values.isEmpty())
+        res.append(qMakePair(QString(WHITE_BALANCE_KEY), values.join(",")));
+
+    values = readSupported(source, "supported-flash-modes", "flash-mode");
+    if (findProperty(source, "video-torch"))
+        values.append("torch");
+    if (!values.isEmpty())
+        res.append(qMakePair(QString(FLASH_KEY), values.join(",")));
+
+    values = readSupported(source, "supported-focus-modes", "focus-mode");
+    if (!values.isEmpty())
+        res.append(qMakePair(QString(FOCUS_KEY), values.join(",")));
+
+    // The range of the open device if the element has one, the range of
+    // the property otherwise
+    if (!readDouble(source, "min-ev-compensation", &min) || !readDouble(source, "max-ev-compensation", &max))
+    {
+        GParamSpec *spec = findProperty(source, "ev-compensation");
+
+        if (spec && G_IS_PARAM_SPEC_FLOAT(spec))
+        {
+            min = G_PARAM_SPEC_FLOAT(spec)->minimum;
+            max = G_PARAM_SPEC_FLOAT(spec)->maximum;
+        }
+        else
+        {
+            min = max = 0;
+        }
+    }
+
+    if (min < max)
+    {
+        QStringList steps;
+        int s;
+
+        for (s=qCeil(min) ; s<=qFloor(max) ; s++)
+            steps.append(QString::number(s));
+
+        res.append(qMakePair(QString(EV_KEY), steps.join(",")));
+    }
+
+    return Photography(res);
+}
+
+bool Photography::isEmpty() const
+{
+    return m_iso.isEmpty() && m_whiteBalance.isEmpty() && m_flash.isEmpty() &&
+           m_focus.isEmpty() && m_exposure.isEmpty();
+}
+
+int Photography::focusDistance(bool video) const
+{
+    const QList<int> &focus = video ? m_videoFocus : m_focus;
+
+    if (focus.contains(ContinuousFocus))
+        return ContinuousFocus;
+    if (focus.contains(InfinityFocus))
+        return InfinityFocus;
+
+    return focus.isEmpty() ? -1 : focus.first();
+}
+
+QString Photography::format(const QList<int> &values)
+{
+    QStringList items;
+    int i;
+
+    for (i=0 ; i<values.size() ; i++)
+        items.append(QString::number(values.at(i)));
+
+    return "[" + items.join(", ") + "]";
+}
@@ -0,0 +1,72 @@
+#ifndef PHOTOGRAPHY_H
+#define PHOTOGRAPHY_H
+
+#include <QList>
+#include <QPair>
+#include <QString>
+
+#include <gst/gst.h>
+
+/*
+ * Photography capabilities of a camera, in the values of QtMultimedia
+ * that the camera app keeps in dconf, so it does not need to probe them
+ * when it starts.
+ *
+ * They are read from the source element while the probe session has the
+ * camera open and returned next to its caps. The values are kept as read,
+ * as comma separated lists under these keys, which is what the probe
+ * cache and recordings store:
+ *
+ *   iso                ISO speeds, 0 for auto
+ *   white-balance      GstPhotography white balance nicks
+ *   flash              GstPhotography flash nicks, and torch when video
+ *                      torch is available
+ *   focus              GstPhotography focus nicks
+ *   ev-compensation    whole exposure compensation steps
+ *
+ * Only the supported-* lists of the element are read. A list the element
+ * does not have is left out, and the outputs use defaults() for it.
+ */
+class Photography
+{
+public:
+    Photography();
+    explicit Photography(const QList<QPair<QString, QString> > &values);
+
+    // The values of the original template, for cameras probed without them
+    static Photography defaults(bool primary);
+
+    // Reads the values of an open source element
+    static Photography probe(GstElement *source);
+
+    bool isEmpty() const;
+
+    // The values as read, see above
+    const QList<QPair<QString, QString> > &values() const { return m_values; }
+
+    const QList<int> &isoValues() const { return m_iso; }
+    const QList<int> &whiteBalanceValues() const { return m_whiteBalance; }
+    const QList<int> &flashValues() const { return m_flash; }
+    const QList<int> &videoFlashValues() const { return m_videoFlash; }
+    const QList<int> &focusValues() const { return m_focus; }
+    const QList<int> &videoFocusValues() const { return m_videoFocus; }
+    // In half steps, as the camera app stores them
+    const QList<int> &exposureValues() const { return m_exposure; }
+    // The focus mode to start in, -1 when unknown
+    int focusDistance(bool video = false) const;
+
+    // "[a, b, c]"
+    static QString format(const QList<int> &values);
+
+private:
+    QList<QPair<QString, QString> > m_values;
+    QList<int> m_iso;
+    QList<int> m_whiteBalance;
+    QList<int> m_flash;
+    QList<int> m_videoFlash;
+    QList<int> m_focus;
+    QList<int> m_videoFocus;
+    QList<int> m_exposure;
+};
+
+#endif // PHOTOGRAPHY_H
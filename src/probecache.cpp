@@ -0,0 +1,208 @@
+#include "probecache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+#include <gst/gst.h>
+
+#define CACHE_MAGIC 0x43524331 // "CRC1"
+#define CACHE_VERSION 3
+
+static void addBuildFingerprint(QCryptographicHash &hash)
+{
+    static const char *props[] = {
+        "/system/build.prop",
+        "/vendor/build.prop",
+        "/system/vendor/build.prop",
+        "/odm/etc/build.prop"
+    };
+    unsigned i;
+
+    for (i=0 ; i<sizeof(props)/sizeof(props[0]) ; i++)
+    {
+        QFile file(props[i]);
+
+        if (!file.open(QIODevice::ReadOnly))
+            continue;
+
+        while (!file.atEnd())
+        {
+            QByteArray line = file.readLine().trimmed();
+
+            if (line.startsWith("ro.build.fingerprint=") ||
+                line.startsWith("ro.vendor.build.fingerprint=") ||
+                line.startsWith("ro.build.version.incremental="))
+            {
+                hash.addData(line);
+            }
+        }
+    }
+}
+
+static void addHalLibraries(QCryptographicHash &hash)
+{
+    static const char *dirs[] = {
+        "/vendor/lib64/hw",
+        "/vendor/lib/hw",
+        "/system/lib64/hw",
+        "/system/lib/hw",
+        "/odm/lib64/hw",
+        "/odm/lib/hw"
+    };
+    unsigned i;
+    int j;
+
+    for (i=0 ; i<sizeof(dirs)/sizeof(dirs[0]) ; i++)
+    {
+        QFileInfoList libs = QDir(dirs[i]).entryInfoList(QStringList() << "camera.*.so", QDir::Files, QDir::Name);
+
+        for (j=0 ; j<libs.size() ; j++)
+        {
+            hash.addData(libs.at(j).absoluteFilePath().toUtf8());
+            hash.addData(QByteArray::number(libs.at(j).size()));
+            hash.addData(QByteArray::number(libs.at(j).lastModified().toMSecsSinceEpoch()));
+        }
+    }
+}
+
+static void addPlugin(QCryptographicHash &hash)
+{
+    GstElementFactory *factory = gst_element_factory_find("droidcamsrc");
+
+    if (!factory)
+    {
+        return;
+    }
+
+    GstPlugin *plugin = gst_plugin_feature_get_plugin(GST_PLUGIN_FEATURE(factory));
+
+    if (plugin)
+    {
+        const gchar *filename = gst_plugin_get_filename(plugin);
+
+        hash.addData(gst_plugin_get_version(plugin));
+
+        if (filename)
+        {
+            QFileInfo info(filename);
+
+            hash.addData(filename);
+            hash.addData(QByteArray::number(info.size()));
+            hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+        }
+
+        gst_object_unref(plugin);
+    }
+
+    gst_object_unref(factory);
+}
+
+ProbeCache::ProbeCache(const QString &filename, QObject *parent) :
+    QObject(parent),
+    m_filename(filename.isEmpty() ? defaultFilename() : filename)
+{
+}
+
+QString ProbeCache::defaultFilename()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/droid-camres/probe.cache";
+}
+
+void ProbeCache::setFingerprint(const QList<QPair<QString, int> > &cameras)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    int i;
+
+    addBuildFingerprint(hash);
+    addHalLibraries(hash);
+    addPlugin(hash);
+
+    for (i=0 ; i<cameras.size() ; i++)
+    {
+        hash.addData(cameras.at(i).first.toUtf8());
+        hash.addData(QByteArray::number(cameras.at(i).second));
+    }
+
+    m_fingerprint = hash.result();
+}
+
+QByteArray ProbeCache::fingerprint() const
+{
+    return m_fingerprint;
+}
+
+bool ProbeCache::load(QList<QList<QPair<QString, QString> > > &caps, QList<Photography> &photography, bool stale)
+{
+    QFile file(m_filename);
+    quint32 magic, version;
+    QByteArray fingerprint;
+    QList<QList<QPair<QString, QString> > > res;
+    QList<QList<QPair<QString, QString> > > values;
+    int i;
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != CACHE_MAGIC || version != CACHE_VERSION)
+    {
+        return false;
+    }
+
+    in >> fingerprint;
+    if (in.status() != QDataStream::Ok || (!stale && fingerprint != m_fingerprint))
+    {
+        return false;
+    }
+
+    in >> res >> values;
+    if (in.status() != QDataStream::Ok || values.size() != res.size())
+    {
+        qWarning("Camres warning: Ignoring corrupt probe cache %s", qPrintable(m_filename));
+        return false;
+    }
+
+    caps = res;
+    photography.clear();
+    for (i=0 ; i<values.size() ; i++)
+        photography.append(Photography(values.at(i)));
+
+    return true;
+}
+
+bool ProbeCache::save(const QList<QList<QPair<QString, QString> > > &caps, const QList<Photography> &photography)
+{
+    QList<QList<QPair<QString, QString> > > values;
+    int i;
+
+    for (i=0 ; i<caps.size() ; i++)
+        values.append(i < photography.size() ? photography.at(i).values() : QList<QPair<QString, QString> >());
+
+    QDir().mkpath(QFileInfo(m_filename).absolutePath());
+
+    QSaveFile file(m_filename);
+
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning("Camres warning: Could not write probe cache %s", qPrintable(m_filename));
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+
+    out << (quint32)CACHE_MAGIC << (quint32)CACHE_VERSION << m_fingerprint << caps << values;
+
+    return file.commit();
+}
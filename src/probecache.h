@@ -0,0 +1,46 @@
+#ifndef PROBECACHE_H
+#define PROBECACHE_H
+
+#include <QObject>
+#include <QStringList>
+
+#include "photography.h"
+
+/*
+ * On-disk cache of the raw caps and photography values probed from each
+ * camera.
+ *
+ * The cache is only valid for the device state it was probed on. That
+ * state is summarised by a fingerprint of the build fingerprint, the
+ * camera HAL libraries, the droidcamsrc plugin and the camera enum.
+ *
+ * File layout (QDataStream, big endian):
+ *   quint32    magic
+ *   quint32    format version
+ *   QByteArray fingerprint (SHA-1)
+ *   QList<QList<QPair<QString, QString> > > caps
+ *   QList<QList<QPair<QString, QString> > > photography, see Photography::values()
+ */
+class ProbeCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProbeCache(const QString &filename = QString(), QObject *parent = 0);
+
+    static QString defaultFilename();
+
+    void setFingerprint(const QList<QPair<QString, int> > &cameras);
+    QByteArray fingerprint() const;
+
+    // With stale the cache is loaded even if the fingerprint differs,
+    // as a last resort for cameras that could not be probed
+    bool load(QList<QList<QPair<QString, QString> > > &caps, QList<Photography> &photography, bool stale = false);
+    bool save(const QList<QList<QPair<QString, QString> > > &caps, const QList<Photography> &photography);
+
+private:
+    QString m_filename;
+    QByteArray m_fingerprint;
+};
+
+#endif // PROBECACHE_H
@@ -0,0 +1,609 @@
+#include "probesession.h"
+#include "camres.h"
+#include "timings.h"
+#include "photography.h"
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <qmath.h>
+
+struct StreamState
+{
+    QMutex lock;
+    QElapsedTimer clock;
+    int frames;
+    qint64 first;
+    qint64 last;
+    double intervalSum;
+    double intervalSquares;
+};
+
+struct StateWait
+{
+    GMainLoop *loop;
+    GstElement *element;
+    GstState state;
+    const QAtomicInt *cancel;
+    bool failed;
+};
+
+static gboolean stateBusCallback(GstBus *, GstMessage *msg, gpointer userData)
+{
+    StateWait *wait = static_cast<StateWait *>(userData);
+
+    switch (GST_MESSAGE_TYPE(msg))
+    {
+    case GST_MESSAGE_ERROR:
+    {
+        GError *err = NULL;
+        gst_message_parse_error(msg, &err, NULL);
+        qWarning("Camres warning: %s", err->message);
+        g_error_free(err);
+        wait->failed = true;
+        g_main_loop_quit(wait->loop);
+        break;
+    }
+    case GST_MESSAGE_ASYNC_DONE:
+        g_main_loop_quit(wait->loop);
+        break;
+    case GST_MESSAGE_STATE_CHANGED:
+        if (GST_MESSAGE_SRC(msg) == GST_OBJECT(wait->element))
+        {
+            GstState state;
+            gst_message_parse_state_changed(msg, NULL, &state, NULL);
+            if (state == wait->state)
+                g_main_loop_quit(wait->loop);
+        }
+        break;
+    default:
+        break;
+    }
+
+    return TRUE;
+}
+
+static gboolean stateTimeout(gpointer userData)
+{
+    StateWait *wait = static_cast<StateWait *>(userData);
+
+    wait->failed = true;
+    g_main_loop_quit(wait->loop);
+
+    return FALSE;
+}
+
+// Checks the cancel flag, and the state itself for elements without a
+// bus, such as the bare caps source
+static gboolean statePoll(gpointer userData)
+{
+    StateWait *wait = static_cast<StateWait *>(userData);
+    GstState current = GST_STATE_VOID_PENDING;
+    GstStateChangeReturn ret = gst_element_get_state(wait->element, &current, NULL, 0);
+
+    if ((wait->cancel && wait->cancel->load()) || ret == GST_STATE_CHANGE_FAILURE)
+    {
+        wait->failed = true;
+        g_main_loop_quit(wait->loop);
+    }
+    else if (ret != GST_STATE_CHANGE_ASYNC && current == wait->state)
+    {
+        g_main_loop_quit(wait->loop);
+    }
+
+    return TRUE;
+}
+
+static GstPadProbeReturn frameProbe(GstPad *, GstPadProbeInfo *, gpointer userData)
+{
+    StreamState *state = static_cast<StreamState *>(userData);
+    qint64 now = state->clock.nsecsElapsed();
+    QMutexLocker locker(&state->lock);
+
+    if (state->frames == 0)
+    {
+        state->first = now;
+    }
+    else
+    {
+        double interval = (now - state->last) / 1000000.0;
+        state->intervalSum += interval;
+        state->intervalSquares += interval * interval;
+    }
+
+    state->last = now;
+    state->frames++;
+
+    return GST_PAD_PROBE_OK;
+}
+
+ProbeSession::ProbeSession(Camres *camres, bool fastProbe, QObject *parent) :
+    QObject(parent),
+    m_camres(camres),
+    m_fastProbe(fastProbe),
+    m_pipelineFailed(false),
+    m_cameraBin(NULL),
+    m_videoSource(NULL),
+    m_viewfinder(NULL),
+    m_capsSource(NULL),
+    m_setupTime(0),
+    m_timeout(0),
+    m_cancel(NULL)
+{
+    m_deadline.start();
+}
+
+ProbeSession::~ProbeSession()
+{
+    if (m_capsSource)
+    {
+        gst_element_set_state(m_capsSource, GST_STATE_NULL);
+        gst_object_unref(m_capsSource);
+    }
+
+    if (m_cameraBin)
+    {
+        gst_element_set_state(m_cameraBin, GST_STATE_NULL);
+        gst_object_unref(m_cameraBin);
+    }
+
+    if (m_viewfinder)
+        gst_object_unref(m_viewfinder);
+
+    if (m_videoSource)
+        gst_object_unref(m_videoSource);
+}
+
+qint64 ProbeSession::setupTime() const
+{
+    return m_setupTime;
+}
+
+void ProbeSession::setTimeout(int timeoutMs)
+{
+    m_timeout = timeoutMs;
+}
+
+void ProbeSession::setCancelFlag(const QAtomicInt *cancel)
+{
+    m_cancel = cancel;
+}
+
+// Milliseconds left for the current camera, never negative
+qint64 ProbeSession::remaining() const
+{
+    if (m_cancel && m_cancel->load())
+    {
+        return 0;
+    }
+
+    if (m_timeout <= 0)
+    {
+        return G_MAXINT;
+    }
+
+    return qMax((qint64)0, m_timeout - m_deadline.elapsed());
+}
+
+bool ProbeSession::setupPipeline(int cam)
+{
+    if (m_cameraBin)
+    {
+        return true;
+    }
+
+    if (m_pipelineFailed)
+    {
+        return false;
+    }
+
+    PhaseTimer phase("create-pipeline", cam);
+    QElapsedTimer timer;
+
+    timer.start();
+    m_pipelineFailed = true;
+
+    GstEncodingProfile *profile = m_camres->profile();
+    if (!profile)
+    {
+        return false;
+    }
+
+    GstElement *cameraBin = gst_element_factory_make("camerabin", NULL);
+    if (!cameraBin)
+    {
+        qCritical("Camres error: Failed to create camerabin.");
+        return false;
+    }
+    gst_object_ref_sink(cameraBin);
+
+    m_videoSource = gst_element_factory_make(m_camres->sourceElement().constData(), NULL);
+    if (!m_videoSource)
+    {
+        qCritical("Camres error: Failed to create videoSource.");
+        gst_object_unref(cameraBin);
+        return false;
+    }
+    gst_object_ref_sink(m_videoSource);
+
+    m_viewfinder = gst_element_factory_make("fakesink", NULL);
+    if (!m_viewfinder)
+    {
+        qCritical("Camres error: Failed to create fake viewfinder.");
+        gst_object_unref(cameraBin);
+        return false;
+    }
+    gst_object_ref_sink(m_viewfinder);
+
+    g_object_set(cameraBin, "camera-source", m_videoSource, NULL);
+    g_object_set(cameraBin, "viewfinder-sink", m_viewfinder, NULL);
+    g_object_set(cameraBin, "video-profile", profile, NULL);
+
+    m_cameraBin = cameraBin;
+    m_pipelineFailed = false;
+    m_setupTime += timer.elapsed();
+
+    return true;
+}
+
+bool ProbeSession::setupCapsSource(int cam)
+{
+    if (m_capsSource)
+    {
+        return true;
+    }
+
+    PhaseTimer phase("create-element", cam);
+    QElapsedTimer timer;
+
+    timer.start();
+
+    m_capsSource = gst_element_factory_make(m_camres->sourceElement().constData(), NULL);
+    if (!m_capsSource)
+    {
+        qCritical("Camres error: Failed to create videoSource.");
+        return false;
+    }
+    gst_object_ref_sink(m_capsSource);
+
+    m_setupTime += timer.elapsed();
+
+    return true;
+}
+
+QList<QPair<QString, QString> > ProbeSession::getCaps(int cam, const QStringList &whichCaps, Photography *photography)
+{
+    m_deadline.restart();
+
+    if (m_fastProbe)
+    {
+        QList<QPair<QString, QString> > res = getCapsFromPads(cam, whichCaps, photography);
+
+        if (!res.isEmpty() || remaining() == 0)
+        {
+            return res;
+        }
+
+        qInfo("Camres: Caps not available before streaming, probing camera %d with camerabin", cam);
+    }
+
+    return getCapsFromPipeline(cam, whichCaps, photography);
+}
+
+QList<QPair<QString, QString> > ProbeSession::getCapsFromPipeline(int cam, const QStringList &whichCaps,
+                                                                  Photography *photography)
+{
+    QList<QPair<QString, QString> > res;
+
+    if (!setupPipeline(cam))
+    {
+        return res;
+    }
+
+    // droidcamsrc only picks up a new camera-device when the device is closed
+    setState(m_cameraBin, GST_STATE_NULL, cam);
+    g_object_set(m_videoSource, "camera-device", cam, NULL);
+
+    if (setState(m_cameraBin, GST_STATE_PLAYING, cam) == GST_STATE_CHANGE_FAILURE)
+    {
+        qCritical("Camres error: Failed to start playback.");
+        setState(m_cameraBin, GST_STATE_NULL, cam);
+        return res;
+    }
+
+    int i;
+
+    for (i=0 ; i<whichCaps.size() ; i++)
+    {
+        PhaseTimer phase("query-caps", cam);
+        GstCaps *caps = NULL;
+
+        g_object_get(m_cameraBin, whichCaps.at(i).toLatin1().constData(), &caps, NULL);
+        res.append(qMakePair<QString, QString>(whichCaps.at(i), Camres::capsToString(caps)));
+
+        if (caps)
+            gst_caps_unref(caps);
+    }
+
+    if (photography)
+    {
+        PhaseTimer phase("query-photography", cam);
+        *photography = Photography::probe(m_videoSource);
+    }
+
+    setState(m_cameraBin, GST_STATE_NULL, cam);
+
+    return res;
+}
+
+QList<QPair<QString, QString> > ProbeSession::getCapsFromPads(int cam, const QStringList &whichCaps,
+                                                              Photography *photography)
+{
+    static const GstState states[] = { GST_STATE_READY, GST_STATE_PAUSED };
+
+    QList<QPair<QString, QString> > res;
+    unsigned s;
+    int i;
+
+    if (!setupCapsSource(cam))
+    {
+        return res;
+    }
+
+    setState(m_capsSource, GST_STATE_NULL, cam);
+    g_object_set(m_capsSource, "camera-device", cam, NULL);
+
+    // Try the lowest state first, some HALs only fill in their parameters
+    // once the device has been started.
+    for (s=0 ; s<sizeof(states)/sizeof(states[0]) && res.isEmpty() && remaining() > 0 ; s++)
+    {
+        if (setState(m_capsSource, states[s], cam) == GST_STATE_CHANGE_FAILURE)
+        {
+            break;
+        }
+
+        for (i=0 ; i<whichCaps.size() ; i++)
+        {
+            PhaseTimer phase("query-caps", cam);
+            GstCaps *caps = queryPadCaps(whichCaps.at(i));
+
+            if (!caps)
+            {
+                res.clear();
+                break;
+            }
+
+            res.append(qMakePair<QString, QString>(whichCaps.at(i), Camres::capsToString(caps)));
+            gst_caps_unref(caps);
+        }
+    }
+
+    // Read while the device is still open, its parameters are known now
+    if (!res.isEmpty() && photography)
+    {
+        PhaseTimer phase("query-photography", cam);
+        *photography = Photography::probe(m_capsSource);
+    }
+
+    setState(m_capsSource, GST_STATE_NULL, cam);
+
+    return res;
+}
+
+GstStateChangeReturn ProbeSession::setState(GstElement *element, GstState state, int cam)
+{
+    PhaseTimer phase(state == GST_STATE_NULL ? "state-null" :
+                     state == GST_STATE_READY ? "state-ready" :
+                     state == GST_STATE_PAUSED ? "state-paused" : "state-playing", cam);
+
+    GstStateChangeReturn ret = gst_element_set_state(element, state);
+
+    if (ret == GST_STATE_CHANGE_ASYNC && state != GST_STATE_NULL)
+    {
+        ret = waitForState(element, state);
+    }
+
+    return ret;
+}
+
+GstStateChangeReturn ProbeSession::waitForState(GstElement *element, GstState state)
+{
+    GMainContext *context = g_main_context_ref_thread_default();
+    GstBus *bus = gst_element_get_bus(element);
+    StateWait wait = { g_main_loop_new(context, FALSE), element, state, m_cancel, false };
+    GstState current = GST_STATE_VOID_PENDING;
+
+    GSource *busSource = bus ? gst_bus_create_watch(bus) : NULL;
+
+    if (busSource)
+    {
+        g_source_set_callback(busSource, (GSourceFunc)stateBusCallback, &wait, NULL);
+        g_source_attach(busSource, context);
+    }
+
+    GSource *timeoutSource = g_timeout_source_new(remaining());
+    g_source_set_callback(timeoutSource, stateTimeout, &wait, NULL);
+    g_source_attach(timeoutSource, context);
+
+    // Without bus messages the state has to be polled more often
+    GSource *pollSource = g_timeout_source_new(busSource ? 50 : 10);
+    g_source_set_callback(pollSource, statePoll, &wait, NULL);
+    g_source_attach(pollSource, context);
+
+    // Stale messages from earlier changes may wake the loop, so check
+    // the state itself; it may also have completed before the watch
+    // was attached
+    while (!wait.failed &&
+           !(gst_element_get_state(element, &current, NULL, 0) != GST_STATE_CHANGE_ASYNC && current == state))
+    {
+        g_main_loop_run(wait.loop);
+    }
+
+    g_source_destroy(pollSource);
+    g_source_unref(pollSource);
+    g_source_destroy(timeoutSource);
+    g_source_unref(timeoutSource);
+    if (busSource)
+    {
+        g_source_destroy(busSource);
+        g_source_unref(busSource);
+    }
+    if (bus)
+        gst_object_unref(bus);
+    g_main_loop_unref(wait.loop);
+    g_main_context_unref(context);
+
+    if (wait.failed)
+    {
+        qWarning("Camres warning: %s did not reach %s in time.", GST_ELEMENT_NAME(element), gst_element_state_get_name(state));
+        return GST_STATE_CHANGE_FAILURE;
+    }
+
+    return GST_STATE_CHANGE_SUCCESS;
+}
+
+GstCaps *ProbeSession::queryPadCaps(const QString &whichCaps)
+{
+    const char *padName;
+
+    // camerabin reads its supported caps properties from these pads too
+    if (whichCaps.startsWith("image"))
+        padName = "imgsrc";
+    else if (whichCaps.startsWith("video"))
+        padName = "vidsrc";
+    else if (whichCaps.startsWith("viewfinder"))
+        padName = "vfsrc";
+    else
+        return NULL;
+
+    GstPad *pad = gst_element_get_static_pad(m_capsSource, padName);
+    if (!pad)
+    {
+        return NULL;
+    }
+
+    GstCaps *caps = gst_pad_query_caps(pad, NULL);
+    GstCaps *templateCaps = gst_pad_get_pad_template_caps(pad);
+
+    // Without an open device droidcamsrc answers with its template caps
+    if (caps && (gst_caps_is_empty(caps) || gst_caps_is_any(caps) ||
+                 (templateCaps && gst_caps_is_equal(caps, templateCaps))))
+    {
+        gst_caps_unref(caps);
+        caps = NULL;
+    }
+
+    if (templateCaps)
+        gst_caps_unref(templateCaps);
+
+    gst_object_unref(pad);
+
+    return caps;
+}
+
+ViewfinderStats ProbeSession::measureViewfinder(int cam, const CamMode &mode, int durationMs)
+{
+    ViewfinderStats res;
+
+    m_deadline.restart();
+
+    if (!setupPipeline(cam))
+    {
+        return res;
+    }
+
+    GstCaps *caps = gst_caps_new_simple("video/x-raw",
+                                        "width", G_TYPE_INT, mode.width,
+                                        "height", G_TYPE_INT, mode.height,
+                                        NULL);
+    if (mode.hasFramerate())
+    {
+        gst_caps_set_simple(caps, "framerate", GST_TYPE_FRACTION, mode.fpsMaxNum, mode.fpsMaxDen, NULL);
+        res.nominalFps = (double)mode.fpsMaxNum / mode.fpsMaxDen;
+    }
+    // Match the memory features of droidcamsrc as well
+    gst_caps_set_features(caps, 0, gst_caps_features_new_any());
+
+    setState(m_cameraBin, GST_STATE_NULL, cam);
+    g_object_set(m_videoSource, "camera-device", cam, NULL);
+    g_object_set(m_cameraBin, "viewfinder-caps", caps, NULL);
+    g_object_set(m_viewfinder, "sync", FALSE, NULL);
+    gst_caps_unref(caps);
+
+    StreamState state;
+    state.frames = 0;
+    state.first = 0;
+    state.last = 0;
+    state.intervalSum = 0;
+    state.intervalSquares = 0;
+
+    GstPad *pad = gst_element_get_static_pad(m_viewfinder, "sink");
+    gulong probe = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, frameProbe, &state, NULL);
+    GstBus *bus = gst_element_get_bus(m_cameraBin);
+    bool done = false;
+    bool complete = false;
+
+    state.clock.start();
+
+    if (setState(m_cameraBin, GST_STATE_PLAYING, cam) == GST_STATE_CHANGE_FAILURE)
+    {
+        qWarning("Camres warning: Failed to stream viewfinder %s of camera %d.", qPrintable(mode.toString()), cam);
+        done = true;
+    }
+
+    // A camera that sends nothing within 5 seconds is not going to, and
+    // the camera timeout bounds the whole measurement
+    qint64 limit = qMin((qint64)durationMs + 5000, state.clock.elapsed() + remaining());
+
+    while (!done && state.clock.elapsed() < limit && remaining() > 0)
+    {
+        GstMessage *msg = gst_bus_timed_pop_filtered(bus, 20 * GST_MSECOND, GST_MESSAGE_ERROR);
+
+        if (msg)
+        {
+            GError *err = NULL;
+            gst_message_parse_error(msg, &err, NULL);
+            qWarning("Camres warning: Viewfinder %s of camera %d failed: %s", qPrintable(mode.toString()), cam, err->message);
+            g_error_free(err);
+            gst_message_unref(msg);
+            done = true;
+        }
+
+        QMutexLocker locker(&state.lock);
+        if (state.frames > 0 && state.last - state.first >= durationMs * (qint64)1000000)
+            done = complete = true;
+    }
+
+    if (!done)
+    {
+        qWarning("Camres warning: Viewfinder %s of camera %d did not deliver %d ms of frames in time.",
+                 qPrintable(mode.toString()), cam, durationMs);
+    }
+
+    setState(m_cameraBin, GST_STATE_NULL, cam);
+    gst_pad_remove_probe(pad, probe);
+    gst_object_unref(pad);
+    gst_object_unref(bus);
+
+    // Leave the pipeline as it was for caps probing
+    caps = gst_caps_new_any();
+    g_object_set(m_cameraBin, "viewfinder-caps", caps, NULL);
+    gst_caps_unref(caps);
+
+    res.frames = state.frames;
+    res.timedOut = !complete;
+
+    if (state.frames > 1)
+    {
+        int intervals = state.frames - 1;
+        double mean = state.intervalSum / intervals;
+
+        res.fps = intervals * 1000000000.0 / (state.last - state.first);
+        res.jitterMs = qSqrt(qMax(0.0, state.intervalSquares / intervals - mean * mean));
+    }
+
+    if (state.frames > 0)
+        res.firstFrameMs = state.first / 1000000.0;
+
+    return res;
+}
@@ -0,0 +1,80 @@
+#ifndef PROBESESSION_H
+#define PROBESESSION_H
+
+#include <QObject>
+#include <QStringList>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+#include <gst/gst.h>
+
+#include "viewfinderindex.h"
+
+class Camres;
+class Photography;
+
+/*
+ * Owns the elements used for probing and reuses them for any number of
+ * cameras. The camera is switched by dropping the element to NULL and
+ * changing camera-device on droidcamsrc.
+ *
+ * With the fast probe enabled the supported caps are first queried from
+ * the pads of a bare droidcamsrc in READY/PAUSED. The full camerabin
+ * pipeline is only built and taken to PLAYING when the HAL does not
+ * report its caps before streaming.
+ *
+ * Asynchronous state changes are waited for on the bus of the element,
+ * or by polling its state when it has no bus, in a main loop on the
+ * thread default context, until the camera
+ * timeout passes or the cancel flag is set. A HAL call that blocks
+ * inside gst_element_set_state() cannot be interrupted, see
+ * Camres::getAllCaps() for how that is bounded.
+ */
+class ProbeSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProbeSession(Camres *camres, bool fastProbe, QObject *parent = 0);
+    virtual ~ProbeSession();
+
+    qint64 setupTime() const;
+
+    // Time allowed for probing one camera, 0 for no limit
+    void setTimeout(int timeoutMs);
+    // The probe gives up as soon as cancel is non-zero
+    void setCancelFlag(const QAtomicInt *cancel);
+
+    // The photography values are read while the camera is open, if
+    // photography is given
+    QList<QPair<QString, QString> > getCaps(int cam, const QStringList &whichCaps, Photography *photography = 0);
+
+    // Streams mode into the fake viewfinder for durationMs after the
+    // first frame. Always uses camerabin. Stops early at the timeout or
+    // when cancelled, the result is then marked as timed out.
+    ViewfinderStats measureViewfinder(int cam, const CamMode &mode, int durationMs);
+
+private:
+    bool setupPipeline(int cam);
+    bool setupCapsSource(int cam);
+    GstStateChangeReturn setState(GstElement *element, GstState state, int cam);
+    GstStateChangeReturn waitForState(GstElement *element, GstState state);
+    qint64 remaining() const;
+    QList<QPair<QString, QString> > getCapsFromPipeline(int cam, const QStringList &whichCaps, Photography *photography);
+    QList<QPair<QString, QString> > getCapsFromPads(int cam, const QStringList &whichCaps, Photography *photography);
+    GstCaps *queryPadCaps(const QString &whichCaps);
+
+    Camres *m_camres;
+    bool m_fastProbe;
+    bool m_pipelineFailed;
+    GstElement *m_cameraBin;
+    GstElement *m_videoSource;
+    GstElement *m_viewfinder;
+    GstElement *m_capsSource;
+    qint64 m_setupTime;
+    int m_timeout;
+    QElapsedTimer m_deadline;
+    const QAtomicInt *m_cancel;
+};
+
+#endif // PROBESESSION_H
@@ -0,0 +1,142 @@
+#include "recording.h"
+#include "outputsink.h"
+
+#include <glib.h>
+
+#define RECORDING_VERSION 2
+
+bool Recording::save(const QString &filename,
+                     const QList<QPair<QString, int> > &cameras,
+                     const QList<QList<QPair<QString, QString> > > &caps,
+                     const QList<Photography> &photography)
+{
+    GKeyFile *keyFile = g_key_file_new();
+    OutputSink sink(filename);
+    int i, j;
+
+    g_key_file_set_integer(keyFile, "droid-camres", "version", RECORDING_VERSION);
+
+    for (i=0 ; i<cameras.size() && i<caps.size() ; i++)
+    {
+        QByteArray group = "camera-" + QByteArray::number(i);
+
+        g_key_file_set_string(keyFile, group.constData(), "name", cameras.at(i).first.toUtf8().constData());
+        g_key_file_set_integer(keyFile, group.constData(), "device", cameras.at(i).second);
+
+        for (j=0 ; j<caps.at(i).size() ; j++)
+        {
+            g_key_file_set_string(keyFile, group.constData(), caps.at(i).at(j).first.toLatin1().constData(),
+                                  caps.at(i).at(j).second.toUtf8().constData());
+        }
+
+        if (i >= photography.size())
+            continue;
+
+        QByteArray photographyGroup = "photography-" + QByteArray::number(i);
+        const QList<QPair<QString, QString> > &values = photography.at(i).values();
+
+        for (j=0 ; j<values.size() ; j++)
+        {
+            g_key_file_set_string(keyFile, photographyGroup.constData(), values.at(j).first.toLatin1().constData(),
+                                  values.at(j).second.toUtf8().constData());
+        }
+    }
+
+    gchar *data = g_key_file_to_data(keyFile, NULL, NULL);
+    sink.stream() << QString::fromUtf8(data);
+    g_free(data);
+    g_key_file_free(keyFile);
+
+    qInfo("Camres: Recording probe results to %s", qPrintable(sink.fileName()));
+
+    return sink.commit();
+}
+
+bool Recording::load(const QString &filename,
+                     QList<QPair<QString, int> > &cameras,
+                     QList<QList<QPair<QString, QString> > > &caps,
+                     QList<Photography> &photography)
+{
+    GKeyFile *keyFile = g_key_file_new();
+    GError *error = NULL;
+    int cam;
+    gsize i;
+
+    if (!g_key_file_load_from_file(keyFile, filename.toLocal8Bit().constData(), G_KEY_FILE_NONE, &error))
+    {
+        qCritical("Camres error: Failed to load recording %s: %s", qPrintable(filename), error->message);
+        g_error_free(error);
+        g_key_file_free(keyFile);
+        return false;
+    }
+
+    if (g_key_file_get_integer(keyFile, "droid-camres", "version", NULL) > RECORDING_VERSION)
+    {
+        qCritical("Camres error: Recording %s has an unsupported version.", qPrintable(filename));
+        g_key_file_free(keyFile);
+        return false;
+    }
+
+    cameras.clear();
+    caps.clear();
+    photography.clear();
+
+    for (cam=0 ; ; cam++)
+    {
+        QByteArray group = "camera-" + QByteArray::number(cam);
+        QByteArray photographyGroup = "photography-" + QByteArray::number(cam);
+        QList<QPair<QString, QString> > cameraCaps;
+        QList<QPair<QString, QString> > values;
+        gsize count = 0;
+
+        if (!g_key_file_has_group(keyFile, group.constData()))
+            break;
+
+        gchar *name = g_key_file_get_string(keyFile, group.constData(), "name", NULL);
+        int device = cam;
+
+        // Fixtures have no device key, their devices are numbered in order
+        if (g_key_file_has_key(keyFile, group.constData(), "device", NULL))
+            device = g_key_file_get_integer(keyFile, group.constData(), "device", NULL);
+
+        cameras.append(qMakePair(name ? QString::fromUtf8(name) : QString("Camera %1").arg(cam), device));
+        g_free(name);
+
+        gchar **keys = g_key_file_get_keys(keyFile, group.constData(), &count, NULL);
+
+        for (i=0 ; i<count ; i++)
+        {
+            if (!g_str_has_suffix(keys[i], "-supported-caps"))
+                continue;
+
+            gchar *value = g_key_file_get_string(keyFile, group.constData(), keys[i], NULL);
+            cameraCaps.append(qMakePair(QString(keys[i]), QString::fromUtf8(value)));
+            g_free(value);
+        }
+
+        g_strfreev(keys);
+        caps.append(cameraCaps);
+
+        keys = g_key_file_get_keys(keyFile, photographyGroup.constData(), &count, NULL);
+
+        for (i=0 ; keys && i<count ; i++)
+        {
+            gchar *value = g_key_file_get_string(keyFile, photographyGroup.constData(), keys[i], NULL);
+            values.append(qMakePair(QString(keys[i]), QString::fromUtf8(value)));
+            g_free(value);
+        }
+
+        g_strfreev(keys);
+        photography.append(Photography(values));
+    }
+
+    g_key_file_free(keyFile);
+
+    if (cameras.isEmpty())
+    {
+        qCritical("Camres error: Recording %s has no cameras.", qPrintable(filename));
+        return false;
+    }
+
+    return true;
+}
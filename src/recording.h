@@ -0,0 +1,49 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <QString>
+#include <QPair>
+#include <QStringList>
+
+#include "photography.h"
+
+/*
+ * Raw probe results of a device, saved with --record and fed back into
+ * the output generators with --replay without opening any camera.
+ *
+ * The file uses the fixture format of tests/fixture, so a recording can
+ * also be probed again with --fixture. Each camera group additionally
+ * holds the camera-device value it was probed with, and the photography
+ * values of the camera are kept in a group of their own:
+ *
+ *   [droid-camres]
+ *   version=2
+ *
+ *   [camera-0]
+ *   name=Primary camera
+ *   device=0
+ *   image-capture-supported-caps=<caps>
+ *   video-capture-supported-caps=<caps>
+ *   viewfinder-supported-caps=<caps>
+ *
+ *   [photography-0]
+ *   iso=<values>
+ *
+ * The caps keys keep the order they were probed in. The photography keys
+ * are described in photography.h, the group is optional.
+ */
+class Recording
+{
+public:
+    static bool save(const QString &filename,
+                     const QList<QPair<QString, int> > &cameras,
+                     const QList<QList<QPair<QString, QString> > > &caps,
+                     const QList<Photography> &photography);
+
+    static bool load(const QString &filename,
+                     QList<QPair<QString, int> > &cameras,
+                     QList<QList<QPair<QString, QString> > > &caps,
+                     QList<Photography> &photography);
+};
+
+#endif // RECORDING_H
@@ -0,0 +1,119 @@
+#include "screengeometry.h"
+
+#include <QDir>
+#include <QFile>
+#include <QRegExp>
+#include <QScreen>
+#include <QtGui/QGuiApplication>
+
+// Parses the first WxH in line, e.g. "1080x2340" or "U:1080x2340p-60"
+static QRect parseMode(const QString &line)
+{
+    QRegExp re("(\\d+)x(\\d+)");
+
+    if (re.indexIn(line) < 0)
+    {
+        return QRect();
+    }
+
+    int width = re.cap(1).toInt();
+    int height = re.cap(2).toInt();
+
+    if (width <= 0 || height <= 0)
+    {
+        return QRect();
+    }
+
+    return QRect(0, 0, width, height);
+}
+
+static QByteArray readFirstLine(const QString &filename)
+{
+    QFile file(filename);
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return QByteArray();
+    }
+
+    return file.readLine().trimmed();
+}
+
+QRect ScreenGeometry::fromString(const QString &size)
+{
+    QRegExp re("(\\d+)x(\\d+)");
+
+    if (!re.exactMatch(size.trimmed()))
+    {
+        return QRect();
+    }
+
+    return parseMode(size);
+}
+
+QRect ScreenGeometry::fromDrm()
+{
+    QDir drm("/sys/class/drm");
+    QStringList connectors = drm.entryList(QStringList() << "card*-*", QDir::Dirs, QDir::Name);
+    int i;
+
+    for (i=0 ; i<connectors.size() ; i++)
+    {
+        QString path = drm.absoluteFilePath(connectors.at(i));
+
+        if (readFirstLine(path + "/status") != "connected")
+            continue;
+
+        // The preferred mode is listed first
+        QRect geometry = parseMode(readFirstLine(path + "/modes"));
+
+        if (geometry.isValid())
+            return geometry;
+    }
+
+    return QRect();
+}
+
+QRect ScreenGeometry::fromFramebuffer()
+{
+    // virtual_size includes the extra buffers used for page flipping,
+    // only the mode has the visible size.
+    return parseMode(readFirstLine("/sys/class/graphics/fb0/modes"));
+}
+
+QRect ScreenGeometry::fromQt()
+{
+    if (!qobject_cast<QGuiApplication *>(QCoreApplication::instance()))
+    {
+        return QRect();
+    }
+
+    QScreen *screen = QGuiApplication::primaryScreen();
+
+    return screen ? screen->availableGeometry() : QRect();
+}
+
+QRect ScreenGeometry::detect(const QString &size)
+{
+    QRect geometry = fromString(size);
+    if (geometry.isValid())
+    {
+        return geometry;
+    }
+
+    geometry = fromDrm();
+    if (geometry.isValid())
+    {
+        qInfo("Camres: Screen size %dx%d from DRM", geometry.width(), geometry.height());
+        return geometry;
+    }
+
+    geometry = fromFramebuffer();
+    if (geometry.isValid())
+    {
+        qInfo("Camres: Screen size %dx%d from framebuffer", geometry.width(), geometry.height());
+        return geometry;
+    }
+
+    return geometry;
+}
@@ -0,0 +1,35 @@
+#ifndef SCREENGEOMETRY_H
+#define SCREENGEOMETRY_H
+
+#include <QRect>
+#include <QString>
+
+/*
+ * Providers for the size of the primary display, used to drop viewfinder
+ * modes larger than the screen.
+ *
+ * The kernel providers read sysfs and work without a display server or
+ * a Qt platform plugin. fromQt() needs a QGuiApplication and is only
+ * meant as the last fallback. All providers return an invalid rect when
+ * the size is not known.
+ */
+class ScreenGeometry
+{
+public:
+    // Explicit size given as WxH
+    static QRect fromString(const QString &size);
+
+    // Preferred mode of the first connected DRM connector
+    static QRect fromDrm();
+
+    // Current mode of fb0
+    static QRect fromFramebuffer();
+
+    // Available geometry of the primary QScreen
+    static QRect fromQt();
+
+    // Tries the explicit size, DRM and the framebuffer in that order
+    static QRect detect(const QString &size = QString());
+};
+
+#endif // SCREENGEOMETRY_H
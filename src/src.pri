@@ -0,0 +1,56 @@
+# Everything but main(), shared by the tool and the tests
+
+CONFIG += link_pkgconfig c++11
+PKGCONFIG += gstreamer-1.0 gstreamer-pbutils-1.0
+
+INCLUDEPATH += $$PWD
+
+DEFINES += APP_VERSION=\\\"$$VERSION\\\"
+DEFINES += GST_PLUGINS_DIR=\\\"$$system(pkg-config --variable=pluginsdir gstreamer-1.0)\\\"
+
+SOURCES += \
+    $$PWD/aspectratio.cpp \
+    $$PWD/batch.cpp \
+    $$PWD/cameraplan.cpp \
+    $$PWD/camhwtemplate.cpp \
+    $$PWD/cammode.cpp \
+    $$PWD/camres.cpp \
+    $$PWD/capabilityblob.cpp \
+    $$PWD/capswalker.cpp \
+    $$PWD/encodebench.cpp \
+    $$PWD/minimalregistry.cpp \
+    $$PWD/outputgen.cpp \
+    $$PWD/outputsink.cpp \
+    $$PWD/photography.cpp \
+    $$PWD/probecache.cpp \
+    $$PWD/probesession.cpp \
+    $$PWD/recording.cpp \
+    $$PWD/screengeometry.cpp \
+    $$PWD/timings.cpp \
+    $$PWD/videotiers.cpp \
+    $$PWD/viewfinderbench.cpp \
+    $$PWD/viewfinderindex.cpp
+
+HEADERS += \
+    $$PWD/aspectratio.h \
+    $$PWD/batch.h \
+    $$PWD/cameraplan.h \
+    $$PWD/camhwtemplate.h \
+    $$PWD/cammode.h \
+    $$PWD/camres.h \
+    $$PWD/camresblob.h \
+    $$PWD/capabilityblob.h \
+    $$PWD/capswalker.h \
+    $$PWD/encodebench.h \
+    $$PWD/minimalregistry.h \
+    $$PWD/outputgen.h \
+    $$PWD/outputsink.h \
+    $$PWD/photography.h \
+    $$PWD/probecache.h \
+    $$PWD/probesession.h \
+    $$PWD/recording.h \
+    $$PWD/screengeometry.h \
+    $$PWD/timings.h \
+    $$PWD/videotiers.h \
+    $$PWD/viewfinderbench.h \
+    $$PWD/viewfinderindex.h
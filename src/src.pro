@@ -0,0 +1,18 @@
+TARGET = droid-camres
+
+include(src.pri)
+
+other.files = ../video.gep ../jolla-camera-hw-template.txt
+other.path = /usr/share/droid-camres
+
+INSTALLS += target
+target.path = /usr/bin
+
+INSTALLS += other
+
+headers.files = camresblob.h
+headers.path = /usr/include/droid-camres
+
+INSTALLS += headers
+
+SOURCES += main.cpp
@@ -0,0 +1,125 @@
+#include "timings.h"
+#include "outputsink.h"
+
+#include <QMutexLocker>
+
+#include <sys/resource.h>
+
+Timings::Timings() :
+    m_enabled(false)
+{
+    m_clock.start();
+}
+
+Timings *Timings::instance()
+{
+    static Timings timings;
+
+    return &timings;
+}
+
+void Timings::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+bool Timings::isEnabled() const
+{
+    return m_enabled;
+}
+
+qint64 Timings::now() const
+{
+    return m_clock.nsecsElapsed();
+}
+
+void Timings::record(const char *phase, int camera, qint64 start, qint64 end)
+{
+    if (!m_enabled)
+    {
+        return;
+    }
+
+    Phase p = { phase, camera, start, end };
+    QMutexLocker locker(&m_lock);
+
+    m_phases.append(p);
+}
+
+void Timings::print() const
+{
+    QMutexLocker locker(&m_lock);
+    int i;
+
+    qInfo("\nTimings:");
+
+    for (i=0 ; i<m_phases.size() ; i++)
+    {
+        const Phase &p = m_phases.at(i);
+
+        if (p.camera < 0)
+            qInfo("%-20s %10.3f ms", p.phase, (p.end - p.start) / 1000000.0);
+        else
+            qInfo("%-20s %10.3f ms (camera %d)", p.phase, (p.end - p.start) / 1000000.0, p.camera);
+    }
+
+    qInfo("%-20s %10.3f ms", "total", now() / 1000000.0);
+    qInfo("%-20s %10lld kB", "peak rss", peakRss());
+}
+
+bool Timings::write(const QString &filename) const
+{
+    QMutexLocker locker(&m_lock);
+    OutputSink sink(filename);
+    QTextStream &ts = sink.stream();
+    int i;
+
+    ts << "{\n";
+    ts << "    \"version\": \"" << APP_VERSION << "\",\n";
+    ts << "    \"totalMs\": " << QString::number(now() / 1000000.0, 'f', 3) << ",\n";
+    ts << "    \"peakRssKb\": " << peakRss() << ",\n";
+    ts << "    \"phases\":\n";
+    ts << "    [\n";
+
+    for (i=0 ; i<m_phases.size() ; i++)
+    {
+        const Phase &p = m_phases.at(i);
+
+        ts << "        { \"phase\": \"" << p.phase << "\", "
+           << "\"camera\": " << p.camera << ", "
+           << "\"startMs\": " << QString::number(p.start / 1000000.0, 'f', 3) << ", "
+           << "\"durationMs\": " << QString::number((p.end - p.start) / 1000000.0, 'f', 3) << " }"
+           << (i == m_phases.size()-1 ? "" : ",") << "\n";
+    }
+
+    ts << "    ]\n";
+    ts << "}\n";
+
+    qInfo("Camres: Writing timings to file %s", qPrintable(filename));
+
+    return sink.commit();
+}
+
+qint64 Timings::peakRss()
+{
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return -1;
+    }
+
+    return usage.ru_maxrss;
+}
+
+PhaseTimer::PhaseTimer(const char *phase, int camera) :
+    m_phase(phase),
+    m_camera(camera),
+    m_start(Timings::instance()->now())
+{
+}
+
+PhaseTimer::~PhaseTimer()
+{
+    Timings::instance()->record(m_phase, m_camera, m_start, Timings::instance()->now());
+}
@@ -0,0 +1,66 @@
+#ifndef TIMINGS_H
+#define TIMINGS_H
+
+#include <QMutex>
+#include <QVector>
+#include <QString>
+#include <QElapsedTimer>
+
+/*
+ * Process wide recorder of phase timings, measured on the monotonic
+ * clock from the start of the run. Recording is thread safe and does
+ * nothing until enabled.
+ */
+class Timings
+{
+public:
+    static Timings *instance();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    // Nanoseconds since the start of the run
+    qint64 now() const;
+
+    // camera is the camera-device value, or -1 for phases of the whole run
+    void record(const char *phase, int camera, qint64 start, qint64 end);
+
+    void print() const;
+    bool write(const QString &filename) const;
+
+    // Peak resident set size in kB
+    static qint64 peakRss();
+
+private:
+    Timings();
+
+    struct Phase
+    {
+        const char *phase;
+        int camera;
+        qint64 start;
+        qint64 end;
+    };
+
+    mutable QMutex m_lock;
+    QVector<Phase> m_phases;
+    QElapsedTimer m_clock;
+    bool m_enabled;
+};
+
+/*
+ * Records the time from construction to destruction as one phase.
+ */
+class PhaseTimer
+{
+public:
+    explicit PhaseTimer(const char *phase, int camera = -1);
+    ~PhaseTimer();
+
+private:
+    const char *m_phase;
+    int m_camera;
+    qint64 m_start;
+};
+
+#endif // TIMINGS_H
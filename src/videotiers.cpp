@@ -0,0 +1,63 @@
+#include "videotiers.h"
+
+const int VideoTiers::Rates[VideoTiers::Count] = { 30, 60, 120, 240 };
+
+bool VideoTiers::framerateFor(const CamMode &mode, int fps, int *num, int *den)
+{
+    if (!mode.hasFramerate())
+    {
+        return false;
+    }
+
+    // fpsNum/fpsDen <= fps <= fpsMaxNum/fpsMaxDen
+    if ((qint64)mode.fpsNum <= (qint64)fps * mode.fpsDen &&
+        (qint64)fps * mode.fpsMaxDen <= (qint64)mode.fpsMaxNum)
+    {
+        *num = fps;
+        *den = 1;
+        return true;
+    }
+
+    // fps * 1000/1001 <= fpsMaxNum/fpsMaxDen < fps
+    if ((qint64)mode.fpsMaxNum * 1001 >= (qint64)fps * 1000 * mode.fpsMaxDen &&
+        (qint64)mode.fpsMaxNum < (qint64)fps * mode.fpsMaxDen)
+    {
+        *num = mode.fpsMaxNum;
+        *den = mode.fpsMaxDen;
+        return true;
+    }
+
+    return false;
+}
+
+QList<VideoTier> VideoTiers::select(const CamModeList &modes)
+{
+    QList<VideoTier> res;
+    int t, m;
+
+    for (t=0 ; t<Count ; t++)
+    {
+        VideoTier tier;
+        tier.fps = Rates[t];
+
+        for (m=0 ; m<modes.size() ; m++)
+        {
+            int num, den;
+
+            if (!framerateFor(modes.at(m), Rates[t], &num, &den))
+                continue;
+
+            if (tier.mode.isValid() && modes.at(m).area() <= tier.mode.area())
+                continue;
+
+            tier.mode = modes.at(m);
+            tier.mode.fpsNum = tier.mode.fpsMaxNum = num;
+            tier.mode.fpsDen = tier.mode.fpsMaxDen = den;
+        }
+
+        if (tier.mode.isValid())
+            res.append(tier);
+    }
+
+    return res;
+}
@@ -0,0 +1,37 @@
+#ifndef VIDEOTIERS_H
+#define VIDEOTIERS_H
+
+#include <QList>
+
+#include "cammode.h"
+
+/*
+ * Largest video mode for each framerate tier, so recording at 60, 120 or
+ * 240 fps can be offered without probing the camera at runtime.
+ *
+ * A mode belongs to a tier when its framerate range contains the tier
+ * rate, or when its top framerate is the NTSC variant of the rate, e.g.
+ * 30000/1001 for 30. All comparisons are done on the exact fractions.
+ */
+struct VideoTier
+{
+    // Nominal rate of the tier
+    int fps;
+    // The mode with its framerate fixed to the one used for the tier
+    CamMode mode;
+};
+
+class VideoTiers
+{
+public:
+    static const int Count = 4;
+    static const int Rates[Count];
+
+    // Tiers with at least one mode, from the lowest rate up
+    static QList<VideoTier> select(const CamModeList &modes);
+
+    // The framerate mode runs at in tier fps, or false if it cannot
+    static bool framerateFor(const CamMode &mode, int fps, int *num, int *den);
+};
+
+#endif // VIDEOTIERS_H
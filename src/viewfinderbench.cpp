@@ -0,0 +1,135 @@
+#include "viewfinderbench.h"
+#include "probesession.h"
+#include "camres.h"
+
+#include <QSet>
+
+// Viewfinder mode with the highest framerate advertised for the
+// resolution of viewfinder
+static CamMode topFramerate(const QList<QPair<QString, CamModeList> > &resolutions, const CamMode &viewfinder)
+{
+    CamMode res = viewfinder;
+    int j, m;
+
+    for (j=0 ; j<resolutions.size() ; j++)
+    {
+        if (CamMode::kindForCaps(resolutions.at(j).first) != CamMode::Viewfinder)
+            continue;
+
+        const CamModeList &modes = resolutions.at(j).second;
+
+        for (m=0 ; m<modes.size() ; m++)
+        {
+            const CamMode &mode = modes.at(m);
+
+            if (!mode.sameResolution(viewfinder) || !mode.hasFramerate())
+                continue;
+
+            if (!res.hasFramerate() ||
+                (qint64)mode.fpsMaxNum * res.fpsMaxDen > (qint64)res.fpsMaxNum * mode.fpsMaxDen)
+            {
+                res.fpsNum = res.fpsMaxNum = mode.fpsMaxNum;
+                res.fpsDen = res.fpsMaxDen = mode.fpsMaxDen;
+            }
+        }
+    }
+
+    return res;
+}
+
+// Aspect ratios of the image and video modes of a camera, the ones a
+// viewfinder is looked up for
+static QSet<const AspectRatio *> captureAspects(const QList<QPair<QString, CamModeList> > &resolutions)
+{
+    QSet<const AspectRatio *> res;
+    int j, m;
+
+    for (j=0 ; j<resolutions.size() ; j++)
+    {
+        CamMode::Kind kind = CamMode::kindForCaps(resolutions.at(j).first);
+
+        if (kind != CamMode::Image && kind != CamMode::Video)
+            continue;
+
+        for (m=0 ; m<resolutions.at(j).second.size() ; m++)
+            res.insert(&AspectRatio::classify(resolutions.at(j).second.at(m)));
+    }
+
+    return res;
+}
+
+ViewfinderBench::ViewfinderBench(Camres *camres, QObject *parent) :
+    QObject(parent),
+    m_camres(camres),
+    m_duration(DefaultDurationMs)
+{
+}
+
+void ViewfinderBench::setDuration(int durationMs)
+{
+    m_duration = durationMs;
+}
+
+void ViewfinderBench::run(const QList<QPair<QString, int> > &cameras,
+                          const QList<QList<QPair<QString, CamModeList> > > &resolutions,
+                          QList<ViewfinderIndex> &viewfinders)
+{
+    ProbeSession session(m_camres, false);
+    int i, m;
+
+    session.setTimeout(m_camres->cameraTimeout());
+
+    for (i=0 ; i<cameras.size() && i<viewfinders.size() ; i++)
+    {
+        QSet<const AspectRatio *> aspects = captureAspects(resolutions.at(i));
+        CamModeList modes = viewfinders.at(i).modes();
+        QHash<CamMode, ViewfinderStats> stats;
+
+        qInfo("Camres: Measuring the viewfinder candidates of %s...", qPrintable(cameras.at(i).first));
+
+        // modes() is sorted by aspect ratio and area, so the order of the
+        // measurements is the same on every run
+        for (m=0 ; m<modes.size() ; m++)
+        {
+            const AspectRatio &aspect = AspectRatio::classify(modes.at(m));
+
+            if (!aspects.contains(&aspect))
+                continue;
+            aspects.remove(&aspect);
+
+            // Measure the mode find() chooses and the ones it compares it
+            // with, until it chooses one that was measured. Each round
+            // measures at least one more mode.
+            for (;;)
+            {
+                CamMode chosen = viewfinders.at(i).find(aspect);
+                int c;
+
+                if (!chosen.isValid() || stats.contains(chosen))
+                    break;
+
+                for (c=0 ; c<modes.size() ; c++)
+                {
+                    const CamMode &candidate = modes.at(c);
+
+                    if (&AspectRatio::classify(candidate) != &aspect || stats.contains(candidate) ||
+                        candidate.area() > chosen.area() || candidate.area() * 10 < chosen.area() * 9)
+                        continue;
+
+                    CamMode mode = topFramerate(resolutions.at(i), candidate);
+                    ViewfinderStats s = session.measureViewfinder(cameras.at(i).second, mode, m_duration);
+
+                    qInfo("Camres: Viewfinder %s delivered %.1f fps, %.2f ms jitter, first frame after %.0f ms%s",
+                          qPrintable(mode.toString()), s.fps, s.jitterMs, s.firstFrameMs,
+                          s.isSustained() ? "" : " (not sustained)");
+
+                    stats.insert(candidate, s);
+                }
+
+                viewfinders[i].setStats(stats);
+            }
+        }
+
+        qInfo("Camres: Measured %d of %d viewfinder modes of %s", stats.size(), modes.size(), qPrintable(cameras.at(i).first));
+    }
+}
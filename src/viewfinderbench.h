@@ -0,0 +1,40 @@
+#ifndef VIEWFINDERBENCH_H
+#define VIEWFINDERBENCH_H
+
+#include <QObject>
+
+#include "viewfinderindex.h"
+
+class Camres;
+
+/*
+ * Streams the viewfinder candidates of each camera into the fake
+ * viewfinder sink of camerabin, without clock sync, and records the
+ * delivered framerate, the jitter between frames and the latency to the
+ * first frame. The candidates are the modes ViewfinderIndex::find()
+ * chooses between for the aspect ratios of the image and video modes,
+ * not every mode that fits on the screen. The results are attached to
+ * the viewfinder indexes, which then prefer modes delivered at their
+ * full rate.
+ */
+class ViewfinderBench : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int DefaultDurationMs = 2000;
+
+    explicit ViewfinderBench(Camres *camres, QObject *parent = 0);
+
+    void setDuration(int durationMs);
+
+    void run(const QList<QPair<QString, int> > &cameras,
+             const QList<QList<QPair<QString, CamModeList> > > &resolutions,
+             QList<ViewfinderIndex> &viewfinders);
+
+private:
+    Camres *m_camres;
+    int m_duration;
+};
+
+#endif // VIEWFINDERBENCH_H
@@ -0,0 +1,191 @@
+#include "viewfinderindex.h"
+
+#include <algorithm>
+
+// By area, then width, so that equal modes end up next to each other
+static bool areaLessThan(const CamMode &a, const CamMode &b)
+{
+    if (a.area() != b.area())
+        return a.area() < b.area();
+
+    return a.width < b.width;
+}
+
+// By ascending width / height, the order of the aspect ratio table
+static bool aspectLessThan(const AspectRatio *a, const AspectRatio *b)
+{
+    return (qint64)a->num * b->den < (qint64)b->num * a->den;
+}
+
+static bool areaBelow(qint64 area, const CamMode &mode)
+{
+    return area < mode.area();
+}
+
+// Differences below these are measurement noise
+static const double JitterMarginMs = 1.0;
+static const double FirstFrameMarginMs = 50.0;
+
+// True when a was measured to run clearly better than b
+static bool runsBetter(const ViewfinderStats &a, const ViewfinderStats &b)
+{
+    if (!a.isValid() || !b.isValid())
+        return false;
+
+    if (a.isSustained() != b.isSustained())
+        return a.isSustained();
+
+    if (!a.isSustained() && a.nominalFps > 0 && b.nominalFps > 0 &&
+        a.fps / a.nominalFps != b.fps / b.nominalFps)
+        return a.fps / a.nominalFps > b.fps / b.nominalFps;
+
+    if (qAbs(a.jitterMs - b.jitterMs) > JitterMarginMs)
+        return a.jitterMs < b.jitterMs;
+
+    return a.firstFrameMs + FirstFrameMarginMs < b.firstFrameMs;
+}
+
+ViewfinderIndex::ViewfinderIndex()
+{
+}
+
+ViewfinderIndex::ViewfinderIndex(const QList<QPair<QString, CamModeList> > &resolutions, const QRect &screenGeometry,
+                                 qint64 memoryBudget)
+{
+    int screenMin = qMin(screenGeometry.height(), screenGeometry.width());
+    int screenMax = qMax(screenGeometry.height(), screenGeometry.width());
+    int j, m;
+
+    for (j=0 ; j<resolutions.size() ; j++)
+    {
+        if (CamMode::kindForCaps(resolutions.at(j).first) != CamMode::Viewfinder)
+            continue;
+
+        const CamModeList &modes = resolutions.at(j).second;
+
+        for (m=0 ; m<modes.size() ; m++)
+        {
+            const CamMode &mode = modes.at(m);
+
+            if (screenMin < qMin(mode.width, mode.height) || screenMax < qMax(mode.width, mode.height))
+                continue;
+
+            if (memoryBudget >= 0 && mode.footprint() > memoryBudget)
+                continue;
+
+            const AspectRatio &aspect = AspectRatio::classify(mode);
+            if (!aspect.isValid())
+                continue;
+
+            m_buckets[&aspect].append(CamMode(mode.width, mode.height, CamMode::Viewfinder));
+        }
+    }
+
+    for (QHash<const AspectRatio *, CamModeList>::iterator it = m_buckets.begin(); it != m_buckets.end(); ++it)
+    {
+        CamModeList &bucket = it.value();
+
+        std::sort(bucket.begin(), bucket.end(), areaLessThan);
+        bucket.erase(std::unique(bucket.begin(), bucket.end()), bucket.end());
+    }
+}
+
+QList<ViewfinderIndex> ViewfinderIndex::build(const QList<QList<QPair<QString, CamModeList> > > &resolutions,
+                                              const QRect &screenGeometry, qint64 memoryBudget)
+{
+    QList<ViewfinderIndex> res;
+    int i;
+
+    for (i=0 ; i<resolutions.size() ; i++)
+        res.append(ViewfinderIndex(resolutions.at(i), screenGeometry, memoryBudget));
+
+    return res;
+}
+
+CamMode ViewfinderIndex::find(const CamMode &capture, qint64 maxArea) const
+{
+    return find(AspectRatio::classify(capture), maxArea);
+}
+
+CamMode ViewfinderIndex::find(const AspectRatio &aspect, qint64 maxArea) const
+{
+    QHash<const AspectRatio *, CamModeList>::const_iterator it = m_buckets.constFind(&aspect);
+
+    if (it == m_buckets.constEnd() || it.value().isEmpty())
+    {
+        return CamMode();
+    }
+
+    const CamModeList &bucket = it.value();
+    bool sustainedOnly = false;
+    int m;
+
+    // Modes not delivered at their full rate are only used when no other
+    // mode of the aspect ratio is
+    for (m=0 ; m<bucket.size() && !sustainedOnly ; m++)
+        sustainedOnly = !isSlow(bucket.at(m));
+
+    CamModeList::const_iterator bound = maxArea < 0 ? bucket.constEnd() :
+                                        std::upper_bound(bucket.constBegin(), bucket.constEnd(), maxArea, areaBelow);
+    CamModeList::const_iterator largest = bucket.constEnd();
+    CamModeList::const_iterator mode;
+
+    for (mode=bound ; mode != bucket.constBegin() ; )
+    {
+        --mode;
+        if (!sustainedOnly || !isSlow(*mode))
+        {
+            largest = mode;
+            break;
+        }
+    }
+
+    if (largest == bucket.constEnd())
+    {
+        return CamMode();
+    }
+
+    // Among the modes within 10% of the area of the largest one, take the
+    // one that was measured to run best
+    CamModeList::const_iterator best = largest;
+
+    for (mode=largest ; mode != bucket.constBegin() && (mode - 1)->area() * 10 >= largest->area() * 9 ; )
+    {
+        --mode;
+        if ((!sustainedOnly || !isSlow(*mode)) && runsBetter(stats(*mode), stats(*best)))
+            best = mode;
+    }
+
+    return *best;
+}
+
+CamModeList ViewfinderIndex::modes() const
+{
+    QList<const AspectRatio *> aspects = m_buckets.keys();
+    CamModeList res;
+    int i;
+
+    std::sort(aspects.begin(), aspects.end(), aspectLessThan);
+
+    for (i=0 ; i<aspects.size() ; i++)
+        res += m_buckets.value(aspects.at(i));
+
+    return res;
+}
+
+void ViewfinderIndex::setStats(const QHash<CamMode, ViewfinderStats> &stats)
+{
+    m_stats = stats;
+}
+
+ViewfinderStats ViewfinderIndex::stats(const CamMode &viewfinder) const
+{
+    return m_stats.value(CamMode(viewfinder.width, viewfinder.height, CamMode::Viewfinder));
+}
+
+bool ViewfinderIndex::isSlow(const CamMode &viewfinder) const
+{
+    QHash<CamMode, ViewfinderStats>::const_iterator it = m_stats.constFind(CamMode(viewfinder.width, viewfinder.height, CamMode::Viewfinder));
+
+    return it != m_stats.constEnd() && !it.value().isSustained();
+}
@@ -0,0 +1,72 @@
+#ifndef VIEWFINDERINDEX_H
+#define VIEWFINDERINDEX_H
+
+#include <QHash>
+#include <QRect>
+
+#include "cammode.h"
+#include "aspectratio.h"
+
+/*
+ * Measured frame delivery of one viewfinder mode, see ViewfinderBench.
+ * nominalFps is 0 when the mode has no framerate. A mode that did not
+ * deliver for the whole duration before the timeout is never sustained.
+ */
+struct ViewfinderStats
+{
+    ViewfinderStats() : frames(0), timedOut(false), fps(0), nominalFps(0), jitterMs(0), firstFrameMs(0) {}
+
+    bool isValid() const { return frames > 0; }
+    bool isSustained() const { return isValid() && !timedOut && fps >= 0.95 * nominalFps; }
+
+    int frames;
+    bool timedOut;
+    double fps;
+    double nominalFps;
+    double jitterMs;
+    double firstFrameMs;
+};
+
+/*
+ * Viewfinder modes of one camera that fit on the screen, bucketed by
+ * aspect ratio and sorted by area. Built once per camera and shared by
+ * all output generators.
+ *
+ * Once measured, modes that are not delivered at their full rate are
+ * only used when no mode of the same aspect ratio is. Of the modes within
+ * 10% of the area of the largest fitting one, the one with the lowest
+ * jitter, then the lowest first frame latency, is chosen.
+ */
+class ViewfinderIndex
+{
+public:
+    ViewfinderIndex();
+    // Modes whose buffer pool exceeds memoryBudget bytes are left out,
+    // a negative budget means no limit
+    ViewfinderIndex(const QList<QPair<QString, CamModeList> > &resolutions, const QRect &screenGeometry,
+                    qint64 memoryBudget = -1);
+
+    static QList<ViewfinderIndex> build(const QList<QList<QPair<QString, CamModeList> > > &resolutions,
+                                        const QRect &screenGeometry, qint64 memoryBudget = -1);
+
+    // Largest viewfinder with the aspect ratio of capture, no larger than maxArea if given,
+    // or a slightly smaller one that was measured to run better
+    CamMode find(const CamMode &capture, qint64 maxArea = -1) const;
+    CamMode find(const AspectRatio &aspect, qint64 maxArea = -1) const;
+
+    // All modes in the index, without framerate, by aspect ratio and area
+    CamModeList modes() const;
+
+    // Replaces the measurements, the modes in the index stay the same
+    void setStats(const QHash<CamMode, ViewfinderStats> &stats);
+    ViewfinderStats stats(const CamMode &viewfinder) const;
+
+private:
+    // Measured and not delivered at full rate
+    bool isSlow(const CamMode &viewfinder) const;
+
+    QHash<const AspectRatio *, CamModeList> m_buckets;
+    QHash<CamMode, ViewfinderStats> m_stats;
+};
+
+#endif // VIEWFINDERINDEX_H
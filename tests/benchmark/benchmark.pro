@@ -0,0 +1,9 @@
+TARGET = tst_benchmark
+
+QT += testlib
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../../src/src.pri)
+
+SOURCES += tst_benchmark.cpp
@@ -0,0 +1,429 @@
+#include <QtTest>
+#include <QRect>
+#include <QVarLengthArray>
+
+#include <gst/gst.h>
+
+#include "camres.h"
+#include "aspectratio.h"
+#include "cameraplan.h"
+#include "camhwtemplate.h"
+#include "capabilityblob.h"
+#include "outputgen.h"
+#include "photography.h"
+#include "viewfinderindex.h"
+
+/*
+ * Benchmarks for caps parsing, aspect ratio classification, viewfinder
+ * matching, planning and output generation, on synthetic caps from a
+ * typical phone sensor up to caps with thousands of modes. Outputs are
+ * generated in memory only. Use the QtTest options for machine-readable
+ * results, e.g. tst_benchmark -o results.xml,xml
+ */
+
+static const int phoneImageSizes[][2] = {
+    { 4160, 3120 }, { 4000, 3000 }, { 4096, 2160 }, { 3840, 2160 }, { 3264, 2448 },
+    { 3120, 3120 }, { 2592, 1944 }, { 2048, 1536 }, { 1920, 1080 }, { 1600, 1200 },
+    { 1280, 960 }, { 1280, 768 }, { 1280, 720 }, { 1088, 1088 }, { 1024, 768 },
+    { 800, 600 }, { 800, 480 }, { 720, 480 }, { 640, 480 }, { 352, 288 }, { 320, 240 }
+};
+
+static const int phoneVideoSizes[][2] = {
+    { 1920, 1080 }, { 1280, 720 }, { 864, 480 }, { 800, 480 }, { 720, 480 },
+    { 640, 480 }, { 480, 320 }, { 352, 288 }, { 320, 240 }, { 176, 144 }
+};
+
+static const int phoneViewfinderSizes[][2] = {
+    { 2048, 1536 }, { 1920, 1080 }, { 1440, 1080 }, { 1280, 960 }, { 1280, 720 },
+    { 1088, 1088 }, { 960, 720 }, { 864, 480 }, { 800, 480 }, { 768, 432 },
+    { 736, 736 }, { 720, 480 }, { 640, 640 }, { 640, 480 }, { 576, 432 },
+    { 480, 320 }, { 384, 288 }, { 352, 288 }, { 320, 240 }, { 240, 160 }, { 176, 144 }
+};
+
+static const char *templateText =
+    "[apps/jolla-camera/primary/image]\n"
+    "imageResolution_4_3='@PRIIMAGE43RES@'\n"
+    "imageResolution_16_9='@PRIIMAGE169RES@'\n"
+    "viewfinderResolution_4_3='@PRIVF43RES@'\n"
+    "viewfinderResolution_16_9='@PRIVF169RES@'\n"
+    "\n"
+    "[apps/jolla-camera/primary/video]\n"
+    "videoResolution='@PRIVIDEORES@'\n"
+    "videoFrameRate=@PRIVIDEOFPS@\n"
+    "\n"
+    "[apps/jolla-camera/secondary/image]\n"
+    "imageResolution_4_3='@SECIMAGE43RES@'\n"
+    "imageResolution_16_9='@SECIMAGE169RES@'\n"
+    "viewfinderResolution_4_3='@SECVF43RES@'\n"
+    "viewfinderResolution_16_9='@SECVF169RES@'\n"
+    "\n"
+    "[apps/jolla-camera/secondary/video]\n"
+    "videoResolution='@SECVIDEORES@'\n"
+    "videoFrameRate=@SECVIDEOFPS@\n";
+
+static QString sizeListCaps(const char *media, const char *format, const int sizes[][2], int count, const char *framerate)
+{
+    QStringList res;
+    int i;
+
+    for (i=0 ; i<count ; i++)
+    {
+        res << QString("%1, format=(string)%2, width=(int)%3, height=(int)%4, framerate=(fraction)%5")
+               .arg(media).arg(format).arg(sizes[i][0]).arg(sizes[i][1]).arg(framerate);
+    }
+
+    return res.join("; ");
+}
+
+static QString intList(int first, int step, int count)
+{
+    QStringList res;
+    int i;
+
+    for (i=0 ; i<count ; i++)
+        res << QString::number(first + i * step);
+
+    return "{ " + res.join(", ") + " }";
+}
+
+static QList<QPair<QString, QString> > cameraCaps(const QString &image, const QString &video, const QString &viewfinder)
+{
+    QList<QPair<QString, QString> > res;
+
+    res << qMakePair(QString("image-capture-supported-caps"), image);
+    res << qMakePair(QString("video-capture-supported-caps"), video);
+    res << qMakePair(QString("viewfinder-supported-caps"), viewfinder);
+
+    return res;
+}
+
+class tst_Benchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void parse_data();
+    void parse();
+    void classify_data();
+    void classify();
+    void match_data();
+    void match();
+    void plan_data();
+    void plan();
+    void json_data();
+    void json();
+    void camhw_data();
+    void camhw();
+    void blob_data();
+    void blob();
+
+private:
+    struct Input
+    {
+        QString name;
+        QList<QPair<QString, int> > cameras;
+        QList<QList<QPair<QString, QString> > > caps;
+        QList<Photography> photography;
+
+        QList<QList<GstCaps *> > parsed;
+        QList<QList<QPair<QString, CamModeList> > > resolutions;
+        QList<ViewfinderIndex> viewfinders;
+        QList<CameraPlan> plans;
+    };
+
+    static Input phoneInput();
+    static Input stressInput();
+    static Input rangeInput();
+
+    void addInputs();
+
+    QList<Input> m_inputs;
+    QRect m_screen;
+    CamhwTemplate m_template;
+};
+
+tst_Benchmark::Input tst_Benchmark::phoneInput()
+{
+    Input input;
+    int imageCount = sizeof(phoneImageSizes) / sizeof(phoneImageSizes[0]);
+    int videoCount = sizeof(phoneVideoSizes) / sizeof(phoneVideoSizes[0]);
+    int viewfinderCount = sizeof(phoneViewfinderSizes) / sizeof(phoneViewfinderSizes[0]);
+
+    input.name = "phone";
+    input.cameras << qMakePair(QString("Primary camera"), 0) << qMakePair(QString("Secondary camera"), 1);
+
+    QList<QPair<QString, QString> > caps = cameraCaps(
+        sizeListCaps("image/jpeg", "JPEG", phoneImageSizes, imageCount, "[ 5/1, 30/1 ]"),
+        sizeListCaps("video/x-raw", "NV21", phoneVideoSizes, videoCount, "[ 15/1, 30/1 ]"),
+        sizeListCaps("video/x-raw", "NV21", phoneViewfinderSizes, viewfinderCount, "[ 15/1, 30/1 ]"));
+
+    input.caps << caps << caps;
+
+    return input;
+}
+
+tst_Benchmark::Input tst_Benchmark::stressInput()
+{
+    Input input;
+    // 40 widths x 25 heights x 4 framerates = 4000 modes per caps
+    QString caps = QString("video/x-raw, format=(string)NV21, width=(int)%1, height=(int)%2, "
+                           "framerate=(fraction){ 15/1, 30/1, 60/1, 120/1 }")
+                   .arg(intList(160, 96, 40)).arg(intList(120, 120, 25));
+
+    input.name = "stress";
+    input.cameras << qMakePair(QString("Primary camera"), 0) << qMakePair(QString("Secondary camera"), 1);
+    input.caps << cameraCaps(caps, caps, caps) << cameraCaps(caps, caps, caps);
+
+    return input;
+}
+
+tst_Benchmark::Input tst_Benchmark::rangeInput()
+{
+    Input input;
+    // 247 widths and 247 heights, walked in lockstep as 4:3 sizes
+    QString caps = "video/x-raw, format=(string)NV21, width=(int)[ 160, 4096, 16 ], height=(int)[ 120, 3072, 12 ], "
+                   "framerate=(fraction){ [ 15/1, 30/1 ], 60/1 }";
+
+    input.name = "range";
+    input.cameras << qMakePair(QString("Primary camera"), 0);
+    input.caps << cameraCaps(caps, caps, caps);
+
+    return input;
+}
+
+void tst_Benchmark::initTestCase()
+{
+    int i, c, k;
+
+    gst_init(0, 0);
+
+    m_screen = QRect(0, 0, 1080, 1920);
+    m_template.parse(templateText);
+
+    m_inputs << phoneInput() << stressInput() << rangeInput();
+
+    for (i=0 ; i<m_inputs.size() ; i++)
+    {
+        Input &input = m_inputs[i];
+
+        for (c=0 ; c<input.caps.size() ; c++)
+        {
+            QList<GstCaps *> parsed;
+
+            for (k=0 ; k<input.caps.at(c).size() ; k++)
+                parsed << gst_caps_from_string(input.caps.at(c).at(k).second.toLatin1().constData());
+
+            input.parsed << parsed;
+            // Keeps the outputs from logging the missing values on every iteration
+            input.photography << Photography::defaults(c == 0);
+        }
+
+        input.resolutions = Camres::parse(input.caps);
+        input.viewfinders = ViewfinderIndex::build(input.resolutions, m_screen);
+        input.plans = CameraPlan::build(input.cameras, input.resolutions, input.viewfinders, -1, input.photography);
+    }
+}
+
+void tst_Benchmark::cleanupTestCase()
+{
+    int i, c, k;
+
+    for (i=0 ; i<m_inputs.size() ; i++)
+    {
+        for (c=0 ; c<m_inputs.at(i).parsed.size() ; c++)
+        {
+            for (k=0 ; k<m_inputs.at(i).parsed.at(c).size() ; k++)
+            {
+                if (m_inputs.at(i).parsed.at(c).at(k))
+                    gst_caps_unref(m_inputs.at(i).parsed.at(c).at(k));
+            }
+        }
+    }
+}
+
+void tst_Benchmark::addInputs()
+{
+    int i, c, k;
+
+    QTest::addColumn<int>("input");
+
+    for (i=0 ; i<m_inputs.size() ; i++)
+    {
+        qint64 modes = 0;
+
+        for (c=0 ; c<m_inputs.at(i).resolutions.size() ; c++)
+        {
+            for (k=0 ; k<m_inputs.at(i).resolutions.at(c).size() ; k++)
+                modes += m_inputs.at(i).resolutions.at(c).at(k).second.size();
+        }
+
+        QTest::newRow(qPrintable(QString("%1 (%2 modes)").arg(m_inputs.at(i).name).arg(modes))) << i;
+    }
+}
+
+void tst_Benchmark::parse_data()
+{
+    addInputs();
+}
+
+void tst_Benchmark::parse()
+{
+    QFETCH(int, input);
+    const Input &in = m_inputs.at(input);
+    qint64 n = 0;
+    int c, k;
+
+    QBENCHMARK {
+        for (c=0 ; c<in.parsed.size() ; c++)
+        {
+            for (k=0 ; k<in.parsed.at(c).size() ; k++)
+                n += Camres::parse(in.parsed.at(c).at(k), CamMode::kindForCaps(in.caps.at(c).at(k).first)).size();
+        }
+    }
+
+    QVERIFY(n > 0);
+}
+
+void tst_Benchmark::classify_data()
+{
+    addInputs();
+}
+
+void tst_Benchmark::classify()
+{
+    QFETCH(int, input);
+    const Input &in = m_inputs.at(input);
+    QVarLengthArray<const AspectRatio *, 256> ratios;
+    qint64 n = 0;
+    int c, k;
+
+    QBENCHMARK {
+        for (c=0 ; c<in.resolutions.size() ; c++)
+        {
+            for (k=0 ; k<in.resolutions.at(c).size() ; k++)
+            {
+                const CamModeList &list = in.resolutions.at(c).at(k).second;
+                ratios.resize(list.size());
+                AspectRatio::classify(list, ratios.data());
+                n += list.isEmpty() ? 0 : ratios.at(0)->num;
+            }
+        }
+    }
+
+    QVERIFY(n > 0);
+}
+
+void tst_Benchmark::match_data()
+{
+    addInputs();
+}
+
+void tst_Benchmark::match()
+{
+    QFETCH(int, input);
+    const Input &in = m_inputs.at(input);
+    qint64 n = 0;
+    int c, k, m;
+
+    QBENCHMARK {
+        QList<ViewfinderIndex> viewfinders = ViewfinderIndex::build(in.resolutions, m_screen);
+
+        for (c=0 ; c<in.resolutions.size() ; c++)
+        {
+            for (k=0 ; k<in.resolutions.at(c).size() ; k++)
+            {
+                const CamModeList &list = in.resolutions.at(c).at(k).second;
+                for (m=0 ; m<list.size() ; m++)
+                    n += viewfinders.at(c).find(list.at(m)).width;
+            }
+        }
+    }
+
+    QVERIFY(n > 0);
+}
+
+void tst_Benchmark::plan_data()
+{
+    addInputs();
+}
+
+void tst_Benchmark::plan()
+{
+    QFETCH(int, input);
+    const Input &in = m_inputs.at(input);
+    QList<CameraPlan> plans;
+
+    QBENCHMARK {
+        plans = CameraPlan::build(in.cameras, in.resolutions, in.viewfinders, -1, in.photography);
+    }
+
+    QCOMPARE(plans.size(), in.cameras.size());
+}
+
+void tst_Benchmark::json_data()
+{
+    addInputs();
+}
+
+void tst_Benchmark::json()
+{
+    QFETCH(int, input);
+    const Input &in = m_inputs.at(input);
+    OutputGen og;
+    QString json;
+
+    QBENCHMARK {
+        json.clear();
+        QTextStream ts(&json);
+        og.writeJson(in.plans, ts);
+        ts.flush();
+    }
+
+    QVERIFY(!json.isEmpty());
+}
+
+void tst_Benchmark::camhw_data()
+{
+    addInputs();
+}
+
+void tst_Benchmark::camhw()
+{
+    QFETCH(int, input);
+    const Input &in = m_inputs.at(input);
+    OutputGen og;
+    QString camhw;
+    QStringList unresolved;
+
+    QBENCHMARK {
+        unresolved.clear();
+        camhw = m_template.render(og.camhwValues(in.plans), &unresolved);
+    }
+
+    QVERIFY(!camhw.isEmpty());
+}
+
+void tst_Benchmark::blob_data()
+{
+    addInputs();
+}
+
+void tst_Benchmark::blob()
+{
+    QFETCH(int, input);
+    const Input &in = m_inputs.at(input);
+    QByteArray blob;
+
+    QBENCHMARK {
+        blob = CapabilityBlob::build(in.plans);
+    }
+
+    QVERIFY(!blob.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(tst_Benchmark)
+
+#include "tst_benchmark.moc"
@@ -0,0 +1,457 @@
+#include "camresfixturesrc.h"
+
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+
+#define GST_USE_UNSTABLE_API
+#include <gst/gst.h>
+#include <gst/basecamerabinsrc/gstbasecamerasrc.h>
+
+// Recordings are fixtures too, version 2 only added their photography groups
+#define FIXTURE_VERSION 2
+
+enum
+{
+    PAD_VIEWFINDER,
+    PAD_IMAGE,
+    PAD_VIDEO,
+    PAD_COUNT
+};
+
+static const char *padNames[PAD_COUNT] = {
+    GST_BASE_CAMERA_SRC_VIEWFINDER_PAD_NAME,
+    GST_BASE_CAMERA_SRC_IMAGE_PAD_NAME,
+    GST_BASE_CAMERA_SRC_VIDEO_PAD_NAME
+};
+static const char *capsKeys[PAD_COUNT] = {
+    "viewfinder-supported-caps",
+    "image-capture-supported-caps",
+    "video-capture-supported-caps"
+};
+
+struct FixtureData
+{
+    QList<QByteArray> names;
+    QList<QByteArray> nicks;
+    QVector<GEnumValue> values;
+    QVector<GstCaps *> caps; // PAD_COUNT per camera
+    guint openDelay;
+    guint startDelay;
+    GstState capsState;
+    GType deviceType;
+};
+
+static FixtureData *fixture = NULL;
+
+enum
+{
+    PROP_0,
+    PROP_CAMERA_DEVICE,
+    PROP_OPEN_DELAY,
+    PROP_START_DELAY
+};
+
+typedef struct
+{
+    GstBaseCameraSrc parent;
+
+    GstElement *sources[PAD_COUNT];
+    GstPad *pads[PAD_COUNT];
+    gint device;
+    guint openDelay;
+    guint startDelay;
+    gint imagesPending;
+    gint recording;
+} CamresFixtureSrc;
+
+typedef struct
+{
+    GstBaseCameraSrcClass parent_class;
+} CamresFixtureSrcClass;
+
+static GstStaticPadTemplate srcTemplates[PAD_COUNT] = {
+    GST_STATIC_PAD_TEMPLATE(GST_BASE_CAMERA_SRC_VIEWFINDER_PAD_NAME, GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY),
+    GST_STATIC_PAD_TEMPLATE(GST_BASE_CAMERA_SRC_IMAGE_PAD_NAME, GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY),
+    GST_STATIC_PAD_TEMPLATE(GST_BASE_CAMERA_SRC_VIDEO_PAD_NAME, GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY)
+};
+
+GType camres_fixture_src_get_type(void);
+
+G_DEFINE_TYPE(CamresFixtureSrc, camres_fixture_src, GST_TYPE_BASE_CAMERA_SRC)
+
+// The fixture in filename, or one without cameras if it cannot be read
+static FixtureData *loadFixture(const char *filename)
+{
+    FixtureData *data = new FixtureData;
+    GKeyFile *keyFile = g_key_file_new();
+    GError *error = NULL;
+    int cam, i;
+
+    data->openDelay = 0;
+    data->startDelay = 0;
+    data->capsState = GST_STATE_READY;
+
+    if (!filename)
+    {
+        qCritical("Camres error: %s is not set, %s has no cameras.", CAMRESFIXTURESRC_ENV, CAMRESFIXTURESRC_NAME);
+    }
+    else if (!g_key_file_load_from_file(keyFile, filename, G_KEY_FILE_NONE, &error))
+    {
+        qCritical("Camres error: Failed to load fixture %s: %s", filename, error->message);
+        g_error_free(error);
+    }
+    else if (g_key_file_get_integer(keyFile, "droid-camres", "version", NULL) > FIXTURE_VERSION)
+    {
+        qCritical("Camres error: Fixture %s has an unsupported version.", filename);
+    }
+    else
+    {
+        gchar *capsState = g_key_file_get_string(keyFile, "droid-camres", "caps-state", NULL);
+
+        data->openDelay = g_key_file_get_integer(keyFile, "droid-camres", "open-delay-ms", NULL);
+        data->startDelay = g_key_file_get_integer(keyFile, "droid-camres", "start-delay-ms", NULL);
+        data->capsState = g_strcmp0(capsState, "paused") == 0 ? GST_STATE_PAUSED : GST_STATE_READY;
+        g_free(capsState);
+
+        for (cam=0 ; ; cam++)
+        {
+            QByteArray group = "camera-" + QByteArray::number(cam);
+
+            if (!g_key_file_has_group(keyFile, group.constData()))
+                break;
+
+            gchar *name = g_key_file_get_string(keyFile, group.constData(), "name", NULL);
+            data->names.append(name ? QByteArray(name) : "Camera " + QByteArray::number(cam));
+            data->nicks.append(group);
+            g_free(name);
+
+            for (i=0 ; i<PAD_COUNT ; i++)
+            {
+                gchar *caps = g_key_file_get_string(keyFile, group.constData(), capsKeys[i], NULL);
+                GstCaps *parsed = caps ? gst_caps_from_string(caps) : NULL;
+
+                // Otherwise the pad would answer with its ANY template
+                // caps, which the probe takes for a camera without caps
+                if (caps && !parsed)
+                    qCritical("Camres error: Invalid %s %s in fixture %s.", group.constData(), capsKeys[i], filename);
+
+                data->caps.append(parsed);
+                g_free(caps);
+            }
+        }
+
+        if (data->names.isEmpty())
+            qCritical("Camres error: Fixture %s has no cameras.", filename);
+    }
+
+    g_key_file_free(keyFile);
+
+    for (i=0 ; i<data->names.size() ; i++)
+    {
+        GEnumValue value = { i, data->names.at(i).constData(), data->nicks.at(i).constData() };
+        data->values.append(value);
+    }
+
+    // The enum needs a value for the default device
+    if (data->values.isEmpty())
+    {
+        GEnumValue none = { 0, "No fixture", "none" };
+        data->values.append(none);
+    }
+
+    GEnumValue terminator = { 0, NULL, NULL };
+    data->values.append(terminator);
+
+    data->deviceType = g_enum_register_static("CamresFixtureDevice", data->values.constData());
+
+    return data;
+}
+
+static GstCaps *camres_fixture_src_caps(CamresFixtureSrc *src, GstPad *pad)
+{
+    int i;
+
+    if (GST_STATE(src) < fixture->capsState)
+    {
+        return NULL;
+    }
+
+    for (i=0 ; i<PAD_COUNT ; i++)
+    {
+        if (src->pads[i] == pad)
+        {
+            GstCaps *caps = fixture->caps.value(src->device * PAD_COUNT + i);
+            return caps ? gst_caps_ref(caps) : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+static gboolean camres_fixture_src_query(GstPad *pad, GstObject *parent, GstQuery *query)
+{
+    CamresFixtureSrc *src = (CamresFixtureSrc *)parent;
+
+    if (GST_QUERY_TYPE(query) == GST_QUERY_CAPS)
+    {
+        GstCaps *filter = NULL;
+        GstCaps *caps = camres_fixture_src_caps(src, pad);
+
+        if (!caps)
+            caps = gst_pad_get_pad_template_caps(pad);
+
+        gst_query_parse_caps(query, &filter);
+
+        if (filter)
+        {
+            GstCaps *tmp = gst_caps_intersect_full(filter, caps, GST_CAPS_INTERSECT_FIRST);
+            gst_caps_unref(caps);
+            caps = tmp;
+        }
+
+        gst_query_set_caps_result(query, caps);
+        gst_caps_unref(caps);
+
+        return TRUE;
+    }
+
+    return gst_proxy_pad_query_default(pad, parent, query);
+}
+
+// Lets one buffer through per image capture
+static GstPadProbeReturn camres_fixture_src_image_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    CamresFixtureSrc *src = (CamresFixtureSrc *)user_data;
+    gint pending;
+
+    Q_UNUSED(pad);
+    Q_UNUSED(info);
+
+    do
+    {
+        pending = g_atomic_int_get(&src->imagesPending);
+        if (pending == 0)
+            return GST_PAD_PROBE_DROP;
+    } while (!g_atomic_int_compare_and_exchange(&src->imagesPending, pending, pending - 1));
+
+    if (pending == 1)
+        gst_base_camera_src_finish_capture(GST_BASE_CAMERA_SRC(src));
+
+    return GST_PAD_PROBE_OK;
+}
+
+// Lets buffers through while recording
+static GstPadProbeReturn camres_fixture_src_video_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    CamresFixtureSrc *src = (CamresFixtureSrc *)user_data;
+
+    Q_UNUSED(pad);
+    Q_UNUSED(info);
+
+    return g_atomic_int_get(&src->recording) ? GST_PAD_PROBE_OK : GST_PAD_PROBE_DROP;
+}
+
+static gboolean camres_fixture_src_set_mode(GstBaseCameraSrc *bsrc, GstCameraBinMode mode)
+{
+    Q_UNUSED(bsrc);
+    Q_UNUSED(mode);
+
+    return TRUE;
+}
+
+static gboolean camres_fixture_src_set_preview(GstBaseCameraSrc *bsrc, GstCaps *caps)
+{
+    Q_UNUSED(bsrc);
+    Q_UNUSED(caps);
+
+    return TRUE;
+}
+
+static gboolean camres_fixture_src_start_capture(GstBaseCameraSrc *bsrc)
+{
+    CamresFixtureSrc *src = (CamresFixtureSrc *)bsrc;
+
+    if (bsrc->mode == MODE_IMAGE)
+        g_atomic_int_set(&src->imagesPending, 1);
+    else
+        g_atomic_int_set(&src->recording, 1);
+
+    return TRUE;
+}
+
+static void camres_fixture_src_stop_capture(GstBaseCameraSrc *bsrc)
+{
+    CamresFixtureSrc *src = (CamresFixtureSrc *)bsrc;
+
+    if (bsrc->mode == MODE_VIDEO)
+    {
+        g_atomic_int_set(&src->recording, 0);
+        gst_base_camera_src_finish_capture(bsrc);
+    }
+}
+
+static GstStateChangeReturn camres_fixture_src_change_state(GstElement *element, GstStateChange transition)
+{
+    CamresFixtureSrc *src = (CamresFixtureSrc *)element;
+
+    switch (transition)
+    {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+        if (fixture->names.isEmpty())
+        {
+            GST_ELEMENT_ERROR(element, RESOURCE, NOT_FOUND, ("No fixture loaded"),
+                              ("Set %s to a fixture file", CAMRESFIXTURESRC_ENV));
+            return GST_STATE_CHANGE_FAILURE;
+        }
+        if (src->openDelay)
+            g_usleep(src->openDelay * G_GUINT64_CONSTANT(1000));
+        break;
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+        if (src->startDelay)
+            g_usleep(src->startDelay * G_GUINT64_CONSTANT(1000));
+        break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+        g_atomic_int_set(&src->imagesPending, 0);
+        g_atomic_int_set(&src->recording, 0);
+        break;
+    default:
+        break;
+    }
+
+    // The live videotestsrc children make the bin return NO_PREROLL,
+    // like droidcamsrc
+    return GST_ELEMENT_CLASS(camres_fixture_src_parent_class)->change_state(element, transition);
+}
+
+static void camres_fixture_src_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+    CamresFixtureSrc *src = (CamresFixtureSrc *)object;
+
+    switch (prop_id)
+    {
+    case PROP_CAMERA_DEVICE:
+        src->device = g_value_get_enum(value);
+        break;
+    case PROP_OPEN_DELAY:
+        src->openDelay = g_value_get_uint(value);
+        break;
+    case PROP_START_DELAY:
+        src->startDelay = g_value_get_uint(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
+static void camres_fixture_src_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+    CamresFixtureSrc *src = (CamresFixtureSrc *)object;
+
+    switch (prop_id)
+    {
+    case PROP_CAMERA_DEVICE:
+        g_value_set_enum(value, src->device);
+        break;
+    case PROP_OPEN_DELAY:
+        g_value_set_uint(value, src->openDelay);
+        break;
+    case PROP_START_DELAY:
+        g_value_set_uint(value, src->startDelay);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
+static void camres_fixture_src_class_init(CamresFixtureSrcClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+    GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+    GstBaseCameraSrcClass *basecamerasrc_class = GST_BASE_CAMERA_SRC_CLASS(klass);
+    int i;
+
+    // The camera-device enum is built from the cameras of the fixture
+    fixture = loadFixture(g_getenv(CAMRESFIXTURESRC_ENV));
+
+    gobject_class->set_property = camres_fixture_src_set_property;
+    gobject_class->get_property = camres_fixture_src_get_property;
+    element_class->change_state = camres_fixture_src_change_state;
+    basecamerasrc_class->set_mode = camres_fixture_src_set_mode;
+    basecamerasrc_class->set_preview = camres_fixture_src_set_preview;
+    basecamerasrc_class->start_capture = camres_fixture_src_start_capture;
+    basecamerasrc_class->stop_capture = camres_fixture_src_stop_capture;
+
+    g_object_class_install_property(gobject_class, PROP_CAMERA_DEVICE,
+        g_param_spec_enum("camera-device", "Camera device", "Camera device from the fixture",
+                          fixture->deviceType, 0, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_OPEN_DELAY,
+        g_param_spec_uint("open-delay", "Open delay", "Delay in ms for opening the camera",
+                          0, G_MAXUINT, fixture->openDelay, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+    g_object_class_install_property(gobject_class, PROP_START_DELAY,
+        g_param_spec_uint("start-delay", "Start delay", "Delay in ms for starting the camera",
+                          0, G_MAXUINT, fixture->startDelay, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    for (i=0 ; i<PAD_COUNT ; i++)
+        gst_element_class_add_static_pad_template(element_class, &srcTemplates[i]);
+
+    gst_element_class_set_static_metadata(element_class,
+        "Camera fixture source", "Source/Video/Device",
+        "Stand-in for droidcamsrc that reports supported caps from a fixture file",
+        "droid-camres");
+}
+
+static void camres_fixture_src_init(CamresFixtureSrc *src)
+{
+    static const GstPadProbeCallback probes[PAD_COUNT] = {
+        NULL,
+        camres_fixture_src_image_probe,
+        camres_fixture_src_video_probe
+    };
+    int i;
+
+    src->device = 0;
+    src->openDelay = fixture->openDelay;
+    src->startDelay = fixture->startDelay;
+    src->imagesPending = 0;
+    src->recording = 0;
+
+    for (i=0 ; i<PAD_COUNT ; i++)
+    {
+        GstPadTemplate *templ = gst_element_class_get_pad_template(GST_ELEMENT_GET_CLASS(src), padNames[i]);
+        GstPad *target;
+
+        src->sources[i] = gst_element_factory_make("videotestsrc", NULL);
+        if (!src->sources[i])
+        {
+            qCritical("Camres error: Failed to create videotestsrc for %s.", padNames[i]);
+            src->pads[i] = gst_ghost_pad_new_no_target_from_template(padNames[i], templ);
+        }
+        else
+        {
+            g_object_set(src->sources[i], "is-live", TRUE, NULL);
+            gst_bin_add(GST_BIN(src), src->sources[i]);
+
+            target = gst_element_get_static_pad(src->sources[i], "src");
+            src->pads[i] = gst_ghost_pad_new_from_template(padNames[i], target, templ);
+            if (probes[i])
+                gst_pad_add_probe(target, GST_PAD_PROBE_TYPE_BUFFER, probes[i], src, NULL);
+            gst_object_unref(target);
+        }
+
+        gst_pad_set_query_function(src->pads[i], camres_fixture_src_query);
+        gst_element_add_pad(GST_ELEMENT(src), src->pads[i]);
+    }
+}
+
+static gboolean plugin_init(GstPlugin *plugin)
+{
+    // Registered even without a fixture, so a cached registry keeps it
+    return gst_element_register(plugin, CAMRESFIXTURESRC_NAME, GST_RANK_NONE, camres_fixture_src_get_type());
+}
+
+GST_PLUGIN_DEFINE(GST_VERSION_MAJOR, GST_VERSION_MINOR, camresfixture,
+                  "Simulated camera for testing droid-camres", plugin_init,
+                  "1.0", "unknown", "droid-camres", "https://github.com/mer-hybris/droid-camres")
@@ -0,0 +1,53 @@
+#ifndef CAMRESFIXTURESRC_H
+#define CAMRESFIXTURESRC_H
+
+/*
+ * camresfixturesrc, a stand-in for droidcamsrc that answers from a
+ * fixture file instead of a camera HAL, so probing can be run and timed
+ * without a device. It is built as its own GStreamer plugin,
+ * libgstcamresfixture.so, and never installed.
+ *
+ * The element is a GstBaseCameraSrc with the camera-device enum and the
+ * vfsrc, imgsrc and vidsrc pads of droidcamsrc, so it works both for the
+ * pad based probe and inside camerabin. Each pad is backed by a live
+ * videotestsrc. The supported caps are reported on the pads once the
+ * element reaches the state given by caps-state. imgsrc only lets a
+ * buffer through while an image is captured, vidsrc while a video is
+ * recorded. Opening (NULL to READY) and starting (READY to PAUSED) the
+ * camera can be delayed to mimic a slow HAL.
+ *
+ * The fixture is read from the file in CAMRES_FIXTURE when the element
+ * is first created.
+ *
+ * Fixture file (GKeyFile):
+ *
+ *   [droid-camres]
+ *   version=2
+ *   open-delay-ms=200
+ *   start-delay-ms=500
+ *   caps-state=ready|paused
+ *
+ *   [camera-0]
+ *   name=Primary camera
+ *   image-capture-supported-caps=<caps>
+ *   video-capture-supported-caps=<caps>
+ *   viewfinder-supported-caps=<caps>
+ *
+ *   [photography-0]
+ *   iso=<values>
+ *
+ * Cameras are numbered from 0 without gaps. A caps key that does not
+ * parse is reported when the fixture is loaded.
+ *
+ * Version 1 has only the groups above without photography. Version 2 is
+ * also what --record writes, see src/recording.h: it adds the optional
+ * [photography-N] group per camera, with the keys described in
+ * src/photography.h, and a device key per camera group. The element
+ * does not implement GstPhotography, so it accepts these but ignores
+ * them; the camera-device values are the camera numbers.
+ */
+
+#define CAMRESFIXTURESRC_NAME "camresfixturesrc"
+#define CAMRESFIXTURESRC_ENV "CAMRES_FIXTURE"
+
+#endif // CAMRESFIXTURESRC_H
@@ -0,0 +1,12 @@
+TEMPLATE = lib
+TARGET = gstcamresfixture
+
+QT = core
+CONFIG += plugin link_pkgconfig c++11
+PKGCONFIG += gstreamer-1.0 gstreamer-plugins-bad-1.0
+LIBS += -lgstbasecamerabinsrc-1.0
+
+SOURCES += camresfixturesrc.cpp
+HEADERS += camresfixturesrc.h
+
+OTHER_FILES += fixture-example.txt
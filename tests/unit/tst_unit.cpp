@@ -0,0 +1,528 @@
+#include <QtTest>
+#include <QRect>
+#include <QRegularExpression>
+#include <QTemporaryFile>
+
+#include <gst/gst.h>
+
+#include "camres.h"
+#include "aspectratio.h"
+#include "cameraplan.h"
+#include "camhwtemplate.h"
+#include "capabilityblob.h"
+#include "camresblob.h"
+#include "capswalker.h"
+#include "videotiers.h"
+#include "viewfinderindex.h"
+
+/*
+ * Unit tests for caps walking, aspect ratio classification, viewfinder
+ * lookups, video tiers, template rendering and the capability blob, on
+ * synthetic caps. No camera, display or GStreamer plugin is involved.
+ */
+
+Q_DECLARE_METATYPE(CamMode)
+
+static QStringList modeStrings(const CamModeList &modes)
+{
+    QStringList res;
+    int i;
+
+    for (i=0 ; i<modes.size() ; i++)
+        res << modes.at(i).toString();
+
+    return res;
+}
+
+static CamModeList walkCaps(const QString &caps)
+{
+    GstCaps *c = gst_caps_from_string(caps.toLatin1().constData());
+    CamModeList res = CapsWalker::modes(c, CamMode::Video);
+
+    if (c)
+        gst_caps_unref(c);
+
+    return res;
+}
+
+static CamMode videoMode(int width, int height, int num, int den, int maxNum, int maxDen)
+{
+    CamMode mode(width, height, CamMode::Video);
+
+    mode.fpsNum = num;
+    mode.fpsDen = den;
+    mode.fpsMaxNum = maxNum;
+    mode.fpsMaxDen = maxDen;
+
+    return mode;
+}
+
+static CamModeList sizes(const int list[][2], int count)
+{
+    CamModeList res;
+    int i;
+
+    for (i=0 ; i<count ; i++)
+        res << CamMode(list[i][0], list[i][1]);
+
+    return res;
+}
+
+static ViewfinderStats measured(double fps, double jitterMs)
+{
+    ViewfinderStats stats;
+
+    stats.frames = 100;
+    stats.fps = fps;
+    stats.nominalFps = 30;
+    stats.jitterMs = jitterMs;
+    stats.firstFrameMs = 200;
+
+    return stats;
+}
+
+static QList<QPair<QString, QString> > cameraCaps(const QString &image, const QString &video, const QString &viewfinder)
+{
+    QList<QPair<QString, QString> > res;
+
+    res << qMakePair(QString("image-capture-supported-caps"), image);
+    res << qMakePair(QString("video-capture-supported-caps"), video);
+    res << qMakePair(QString("viewfinder-supported-caps"), viewfinder);
+
+    return res;
+}
+
+class tst_Unit : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void walk_data();
+    void walk();
+    void walkEndpoints();
+    void walkFormat();
+    void classify_data();
+    void classify();
+    void viewfinderFind();
+    void viewfinderStats();
+    void framerateFor_data();
+    void framerateFor();
+    void tiers();
+    void templateRender();
+    void blob();
+    void blobVerify();
+
+private:
+    QList<CameraPlan> blobPlans() const;
+
+    QRect m_screen;
+};
+
+void tst_Unit::initTestCase()
+{
+    gst_init(0, 0);
+
+    m_screen = QRect(0, 0, 1080, 1920);
+}
+
+void tst_Unit::walk_data()
+{
+    QTest::addColumn<QString>("caps");
+    QTest::addColumn<QStringList>("modes");
+
+    QTest::newRow("continuous range")
+        << "video/x-raw, width=(int)[ 176, 4096 ], height=(int)[ 144, 3072 ]"
+        << (QStringList() << "176x144" << "4096x3072");
+    QTest::newRow("stepped range")
+        << "video/x-raw, width=(int)[ 160, 480, 160 ], height=(int)[ 120, 360, 120 ]"
+        << (QStringList() << "160x120" << "320x240" << "480x360");
+    QTest::newRow("lists")
+        << "video/x-raw, width=(int){ 320, 640 }, height=(int){ 240, 480 }"
+        << (QStringList() << "320x240" << "320x480" << "640x240" << "640x480");
+    QTest::newRow("list and range")
+        << "video/x-raw, width=(int){ 320, 640 }, height=(int)[ 240, 480 ]"
+        << (QStringList() << "320x240" << "320x480" << "640x240" << "640x480");
+    QTest::newRow("framerate list")
+        << "video/x-raw, width=(int)640, height=(int)480, framerate=(fraction){ 15/1, 30/1 }"
+        << (QStringList() << "640x480@15/1" << "640x480@30/1");
+    QTest::newRow("framerate range")
+        << "video/x-raw, width=(int)640, height=(int)480, framerate=(fraction)[ 15/1, 30000/1001 ]"
+        << (QStringList() << "640x480@15/1-30000/1001");
+    QTest::newRow("structures")
+        << "video/x-raw, width=(int)640, height=(int)480; image/jpeg, width=(int)4000, height=(int)3000"
+        << (QStringList() << "640x480" << "4000x3000");
+    QTest::newRow("no size")
+        << "video/x-raw, format=(string)NV21"
+        << QStringList();
+}
+
+void tst_Unit::walk()
+{
+    QFETCH(QString, caps);
+    QFETCH(QStringList, modes);
+
+    QCOMPARE(modeStrings(walkCaps(caps)), modes);
+}
+
+void tst_Unit::walkEndpoints()
+{
+    // Three widths but two heights: only the smallest and largest sizes
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression("^Camres warning: Width and height ranges differ in steps"));
+
+    QCOMPARE(modeStrings(walkCaps("video/x-raw, width=(int)[ 160, 480, 160 ], height=(int)[ 120, 240, 120 ]")),
+             QStringList() << "160x120" << "480x240");
+}
+
+void tst_Unit::walkFormat()
+{
+    CamModeList modes = walkCaps("video/x-raw, format=(string){ NV21, YUY2, NV12 }, width=(int)640, height=(int)480");
+
+    QCOMPARE(modes.size(), 1);
+    QCOMPARE(modes.at(0).format, QByteArray("YUY2"));
+    QCOMPARE(modes.at(0).kind, CamMode::Video);
+
+    modes = walkCaps("image/jpeg, width=(int)640, height=(int)480");
+
+    QCOMPARE(modes.size(), 1);
+    QCOMPARE(modes.at(0).format, QByteArray("image/jpeg"));
+}
+
+void tst_Unit::classify_data()
+{
+    QTest::addColumn<int>("width");
+    QTest::addColumn<int>("height");
+    QTest::addColumn<double>("tolerance");
+    QTest::addColumn<QString>("name");
+
+    // A copy, the data stream takes its values by reference
+    double loose = AspectRatio::DefaultTolerance;
+
+    QTest::newRow("4:3") << 4000 << 3000 << loose << "4:3";
+    QTest::newRow("16:9") << 1920 << 1080 << loose << "16:9";
+    QTest::newRow("3:4") << 768 << 1024 << loose << "3:4";
+    QTest::newRow("1:1") << 1088 << 1088 << loose << "1:1";
+    QTest::newRow("close to 16:9") << 1920 << 1088 << loose << "16:9";
+    QTest::newRow("close, strict") << 1920 << 1088 << 0.001 << "?:?";
+    QTest::newRow("portrait 16:9") << 1080 << 1920 << loose << "?:?";
+    QTest::newRow("too wide") << 1000 << 100 << loose << "?:?";
+    QTest::newRow("empty") << 0 << 480 << loose << "?:?";
+}
+
+void tst_Unit::classify()
+{
+    QFETCH(int, width);
+    QFETCH(int, height);
+    QFETCH(double, tolerance);
+    QFETCH(QString, name);
+
+    const AspectRatio &aspect = AspectRatio::classify(width, height, tolerance);
+
+    QCOMPARE(QString(aspect.name), name);
+    QCOMPARE(aspect.isValid(), name != "?:?");
+    QCOMPARE(&AspectRatio::classify(CamMode(width, height), tolerance), &aspect);
+}
+
+void tst_Unit::viewfinderFind()
+{
+    static const int viewfinders[][2] = {
+        { 640, 480 }, { 1920, 1080 }, { 1280, 960 }, { 1440, 1080 }, { 1280, 720 },
+        { 2560, 1920 }, { 1080, 1920 }, { 1000, 100 }, { 1440, 1080 }
+    };
+    static const int images[][2] = { { 4000, 3000 } };
+    QList<QPair<QString, CamModeList> > resolutions;
+
+    resolutions << qMakePair(QString("image-capture-supported-caps"), sizes(images, 1));
+    resolutions << qMakePair(QString("viewfinder-supported-caps"), sizes(viewfinders, 9));
+
+    ViewfinderIndex index(resolutions, m_screen);
+
+    // Larger than the screen, portrait and unknown ratios are left out,
+    // as are the image modes and duplicates
+    QCOMPARE(modeStrings(index.modes()),
+             QStringList() << "640x480" << "1280x960" << "1440x1080" << "1280x720" << "1920x1080");
+
+    QCOMPARE(index.find(AspectRatio::classify(4, 3)), CamMode(1440, 1080, CamMode::Viewfinder));
+    QCOMPARE(index.find(AspectRatio::classify(16, 9)), CamMode(1920, 1080, CamMode::Viewfinder));
+    QCOMPARE(index.find(CamMode(4000, 3000, CamMode::Image)), CamMode(1440, 1080, CamMode::Viewfinder));
+    QCOMPARE(index.find(AspectRatio::classify(4, 3), 1280 * 960), CamMode(1280, 960, CamMode::Viewfinder));
+    QCOMPARE(index.find(AspectRatio::classify(4, 3), 1440 * 1080 - 1), CamMode(1280, 960, CamMode::Viewfinder));
+    QVERIFY(!index.find(AspectRatio::classify(4, 3), 640 * 480 - 1).isValid());
+    QVERIFY(!index.find(AspectRatio::classify(1, 1)).isValid());
+    QVERIFY(!index.find(AspectRatio::unknown()).isValid());
+
+    // A smaller screen
+    ViewfinderIndex small(resolutions, QRect(0, 0, 720, 1280));
+
+    QCOMPARE(small.find(AspectRatio::classify(4, 3)), CamMode(640, 480, CamMode::Viewfinder));
+    QCOMPARE(small.find(AspectRatio::classify(16, 9)), CamMode(1280, 720, CamMode::Viewfinder));
+}
+
+void tst_Unit::viewfinderStats()
+{
+    static const int viewfinders[][2] = { { 1920, 1080 }, { 1824, 1026 }, { 1280, 720 }, { 1440, 1080 }, { 1280, 960 } };
+    QList<QPair<QString, CamModeList> > resolutions;
+    QHash<CamMode, ViewfinderStats> stats;
+
+    resolutions << qMakePair(QString("viewfinder-supported-caps"), sizes(viewfinders, 5));
+
+    ViewfinderIndex index(resolutions, m_screen);
+
+    QCOMPARE(index.find(AspectRatio::classify(16, 9)), CamMode(1920, 1080, CamMode::Viewfinder));
+
+    // Within 10% of the largest area, the one with clearly lower jitter
+    stats.insert(CamMode(1920, 1080, CamMode::Viewfinder), measured(30, 8));
+    stats.insert(CamMode(1824, 1026, CamMode::Viewfinder), measured(30, 2));
+    // Not delivered at full rate, so left out while another one is
+    stats.insert(CamMode(1440, 1080, CamMode::Viewfinder), measured(20, 1));
+    index.setStats(stats);
+
+    QCOMPARE(index.find(AspectRatio::classify(16, 9)), CamMode(1824, 1026, CamMode::Viewfinder));
+    QCOMPARE(index.find(AspectRatio::classify(4, 3)), CamMode(1280, 960, CamMode::Viewfinder));
+    QVERIFY(index.stats(CamMode(1824, 1026)).isSustained());
+    QVERIFY(!index.stats(CamMode(1280, 720)).isValid());
+
+    // Noise in the jitter does not count
+    stats.insert(CamMode(1824, 1026, CamMode::Viewfinder), measured(30, 7.5));
+    index.setStats(stats);
+
+    QCOMPARE(index.find(AspectRatio::classify(16, 9)), CamMode(1920, 1080, CamMode::Viewfinder));
+
+    // Measured again at full rate, the mode is used again
+    stats.insert(CamMode(1440, 1080, CamMode::Viewfinder), measured(30, 1));
+    index.setStats(stats);
+
+    QCOMPARE(index.modes().size(), 5);
+    QCOMPARE(index.find(AspectRatio::classify(4, 3)), CamMode(1440, 1080, CamMode::Viewfinder));
+}
+
+void tst_Unit::framerateFor_data()
+{
+    QTest::addColumn<CamMode>("mode");
+    QTest::addColumn<int>("fps");
+    QTest::addColumn<bool>("found");
+    QTest::addColumn<int>("num");
+    QTest::addColumn<int>("den");
+
+    QTest::newRow("fixed") << videoMode(1920, 1080, 30, 1, 30, 1) << 30 << true << 30 << 1;
+    QTest::newRow("30000/1001") << videoMode(1920, 1080, 30000, 1001, 30000, 1001) << 30 << true << 30000 << 1001;
+    QTest::newRow("60000/1001") << videoMode(1920, 1080, 60000, 1001, 60000, 1001) << 60 << true << 60000 << 1001;
+    QTest::newRow("60000/1001 for 30") << videoMode(1920, 1080, 60000, 1001, 60000, 1001) << 30 << false << 0 << 0;
+    QTest::newRow("29/1") << videoMode(1920, 1080, 29, 1, 29, 1) << 30 << false << 0 << 0;
+    QTest::newRow("in range") << videoMode(1920, 1080, 15, 1, 120, 1) << 60 << true << 60 << 1;
+    QTest::newRow("range up to 30000/1001") << videoMode(1920, 1080, 15, 1, 30000, 1001) << 30 << true << 30000 << 1001;
+    QTest::newRow("above range") << videoMode(1920, 1080, 15, 1, 30, 1) << 60 << false << 0 << 0;
+    QTest::newRow("below range") << videoMode(1920, 1080, 60, 1, 120, 1) << 30 << false << 0 << 0;
+    QTest::newRow("no framerate") << CamMode(1920, 1080, CamMode::Video) << 30 << false << 0 << 0;
+}
+
+void tst_Unit::framerateFor()
+{
+    QFETCH(CamMode, mode);
+    QFETCH(int, fps);
+    QFETCH(bool, found);
+    QFETCH(int, num);
+    QFETCH(int, den);
+    int n = 0, d = 0;
+
+    QCOMPARE(VideoTiers::framerateFor(mode, fps, &n, &d), found);
+
+    if (found)
+    {
+        QCOMPARE(n, num);
+        QCOMPARE(d, den);
+    }
+}
+
+void tst_Unit::tiers()
+{
+    CamModeList modes;
+
+    modes << videoMode(1920, 1080, 30000, 1001, 30000, 1001);
+    modes << videoMode(1280, 720, 15, 1, 120, 1);
+    modes << videoMode(640, 480, 120, 1, 120, 1);
+
+    QList<VideoTier> tiers = VideoTiers::select(modes);
+
+    QCOMPARE(tiers.size(), 3);
+    QCOMPARE(tiers.at(0).fps, 30);
+    QCOMPARE(tiers.at(0).mode.toString(), QString("1920x1080@30000/1001"));
+    QCOMPARE(tiers.at(1).fps, 60);
+    QCOMPARE(tiers.at(1).mode.toString(), QString("1280x720@60/1"));
+    QCOMPARE(tiers.at(2).fps, 120);
+    QCOMPARE(tiers.at(2).mode.toString(), QString("1280x720@120/1"));
+
+    QVERIFY(VideoTiers::select(CamModeList() << CamMode(1920, 1080, CamMode::Video)).isEmpty());
+}
+
+void tst_Unit::templateRender()
+{
+    CamhwTemplate camhw;
+    QHash<QString, QString> values;
+    QStringList unresolved;
+
+    camhw.parse("a='@A@'\n"
+                "b='@B@'\n"
+                "c=@C@ @A@\n"
+                "mail=someone@example.com @ @@ @a@\n");
+
+    QCOMPARE(camhw.keys(), QStringList() << "A" << "B" << "C");
+
+    values.insert("A", "1");
+    values.insert("B", "");
+    values.insert("D", "unused");
+
+    QCOMPARE(camhw.render(values, &unresolved),
+             QString("a='1'\n"
+                     "b='@B@'\n"
+                     "c=@C@ 1\n"
+                     "mail=someone@example.com @ @@ @a@\n"));
+    QCOMPARE(unresolved, QStringList() << "B (line 2)" << "C (line 3)");
+
+    values.insert("B", "2");
+    values.insert("C", "3");
+    unresolved.clear();
+
+    QCOMPARE(camhw.render(values, &unresolved).section('\n', 0, 2), QString("a='1'\nb='2'\nc=3 1"));
+    QVERIFY(unresolved.isEmpty());
+}
+
+QList<CameraPlan> tst_Unit::blobPlans() const
+{
+    QList<QPair<QString, int> > cameras;
+    QList<QList<QPair<QString, QString> > > caps;
+
+    cameras << qMakePair(QString("Primary camera"), 0) << qMakePair(QString("Secondary camera"), 1);
+    caps << cameraCaps("image/jpeg, width=(int)4000, height=(int)3000; image/jpeg, width=(int)1920, height=(int)1080",
+                       "video/x-raw, format=(string)NV21, width=(int)1920, height=(int)1080, "
+                       "framerate=(fraction)[ 15/1, 30/1 ]",
+                       "video/x-raw, format=(string)NV21, width=(int)1440, height=(int)1080, framerate=(fraction)30/1; "
+                       "video/x-raw, format=(string)NV21, width=(int)1920, height=(int)1080, framerate=(fraction)30/1");
+    caps << cameraCaps("image/jpeg, width=(int)1600, height=(int)1200",
+                       "",
+                       "video/x-raw, format=(string)NV21, width=(int)800, height=(int)600, framerate=(fraction)30/1");
+
+    QList<QList<QPair<QString, CamModeList> > > resolutions = Camres::parse(caps);
+
+    return CameraPlan::build(cameras, resolutions, ViewfinderIndex::build(resolutions, m_screen));
+}
+
+void tst_Unit::blob()
+{
+    QByteArray data = CapabilityBlob::build(blobPlans());
+    const CamresBlobHeader *blob = camres_blob_open(data.constData(), data.size());
+
+    QVERIFY(blob);
+    QCOMPARE(blob->size, (uint32_t)data.size());
+    QCOMPARE(blob->camera_count, 2u);
+
+    const CamresBlobCamera *primary = camres_blob_camera(blob, 0);
+    const CamresBlobCamera *secondary = camres_blob_camera(blob, 1);
+
+    QVERIFY(primary && secondary);
+    QVERIFY(!camres_blob_camera(blob, 2));
+    QCOMPARE(QString(camres_blob_string(blob, primary->name)), QString("Primary camera"));
+    QCOMPARE(QString(camres_blob_string(blob, secondary->name)), QString("Secondary camera"));
+    QCOMPARE(primary->device, 0);
+    QCOMPARE(secondary->device, 1);
+
+    // Primary: images 4000x3000 (4:3) and 1920x1080 (16:9), one video,
+    // then the two viewfinders they are paired with
+    QCOMPARE(primary->first_mode, 0u);
+    QCOMPARE(primary->mode_count, 5u);
+    QCOMPARE(secondary->first_mode, 5u);
+    QCOMPARE(secondary->mode_count, 2u);
+    QCOMPARE(blob->mode_count, 7u);
+
+    static const struct
+    {
+        uint32_t width, height, fpsNum, fpsDen, kind;
+        const char *aspect;
+        uint32_t viewfinder;
+    } expected[] = {
+        { 4000, 3000, 0, 0, CAMRES_BLOB_IMAGE, "4:3", 3 },
+        { 1920, 1080, 0, 0, CAMRES_BLOB_IMAGE, "16:9", 4 },
+        { 1920, 1080, 30, 1, CAMRES_BLOB_VIDEO, "16:9", 4 },
+        { 1440, 1080, 0, 0, CAMRES_BLOB_VIEWFINDER, "4:3", CAMRES_BLOB_NONE },
+        { 1920, 1080, 0, 0, CAMRES_BLOB_VIEWFINDER, "16:9", CAMRES_BLOB_NONE },
+        { 1600, 1200, 0, 0, CAMRES_BLOB_IMAGE, "4:3", 6 },
+        { 800, 600, 0, 0, CAMRES_BLOB_VIEWFINDER, "4:3", CAMRES_BLOB_NONE }
+    };
+    uint32_t m;
+
+    for (m=0 ; m<blob->mode_count ; m++)
+    {
+        const CamresBlobMode *mode = camres_blob_mode(blob, m);
+        const CamresBlobAspect *aspect = camres_blob_aspect(blob, mode->aspect);
+
+        QVERIFY(aspect);
+        QCOMPARE(mode->width, expected[m].width);
+        QCOMPARE(mode->height, expected[m].height);
+        QCOMPARE(mode->fps_num, expected[m].fpsNum);
+        QCOMPARE(mode->fps_den, expected[m].fpsDen);
+        QCOMPARE(mode->kind, expected[m].kind);
+        QCOMPARE(QString(camres_blob_string(blob, aspect->name)), QString(expected[m].aspect));
+        QCOMPARE(mode->viewfinder, expected[m].viewfinder);
+    }
+
+    QVERIFY(!camres_blob_mode(blob, blob->mode_count));
+    QCOMPARE(blob->aspect_count, 2u);
+
+    // Damaged headers are rejected
+    QByteArray damaged = data;
+    ((CamresBlobHeader *)damaged.data())->version++;
+    QVERIFY(!camres_blob_open(damaged.constData(), damaged.size()));
+
+    damaged = data;
+    damaged.chop(1);
+    QVERIFY(!camres_blob_open(damaged.constData(), damaged.size()));
+
+    damaged = data;
+    ((CamresBlobHeader *)damaged.data())->modes += 2;
+    QVERIFY(!camres_blob_open(damaged.constData(), damaged.size()));
+
+    damaged = data;
+    damaged[damaged.size() - 1] = 'x';
+    QVERIFY(!camres_blob_open(damaged.constData(), damaged.size()));
+}
+
+void tst_Unit::blobVerify()
+{
+    QByteArray data = CapabilityBlob::build(blobPlans());
+    QTemporaryFile file;
+
+    QVERIFY(file.open());
+    QCOMPARE(file.write(data), (qint64)data.size());
+    file.close();
+
+    QVERIFY(CapabilityBlob::verify(file.fileName()));
+
+    // A mode of an unknown kind and a viewfinder index out of range
+    const CamresBlobHeader *header = (const CamresBlobHeader *)data.constData();
+    CamresBlobMode *modes = (CamresBlobMode *)(data.data() + header->modes);
+    modes[0].kind = 7;
+    modes[1].viewfinder = header->mode_count;
+
+    QVERIFY(file.open());
+    QVERIFY(file.resize(0));
+    QCOMPARE(file.write(data), (qint64)data.size());
+    file.close();
+
+    QTest::ignoreMessage(QtCriticalMsg, "Camres error: Mode 0 is invalid.");
+    QTest::ignoreMessage(QtCriticalMsg, "Camres error: Mode 1 is invalid.");
+    QVERIFY(!CapabilityBlob::verify(file.fileName()));
+
+    // Not a blob at all
+    QVERIFY(file.open());
+    QVERIFY(file.resize(0));
+    QCOMPARE(file.write("CAMRESB"), (qint64)7);
+    file.close();
+
+    QTest::ignoreMessage(QtCriticalMsg, QRegularExpression("^Camres error: .* is not a capability blob of version 1\\.$"));
+    QVERIFY(!CapabilityBlob::verify(file.fileName()));
+}
+
+QTEST_GUILESS_MAIN(tst_Unit)
+
+#include "tst_unit.moc"
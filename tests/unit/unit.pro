@@ -0,0 +1,9 @@
+TARGET = tst_unit
+
+QT += testlib
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../../src/src.pri)
+
+SOURCES += tst_unit.cpp